@@ -0,0 +1,1469 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+
+#define MAX_THREADS     64
+#define MAX_QUERIES     64
+#define BENCH_ROUNDS    4   // The number of times each scan of the benchmark is timed
+
+/**
+ * @brief Batch modes
+ */
+#define MODE_DEDUP  1   // Group files by image payload digest
+#define MODE_PROBE  2   // Print frame parameters
+#define MODE_WHERE  3   // Print the paths of files matching a predicate
+#define MODE_GPS    4   // Print the positions of files, or answer spatial queries over them
+#define MODE_WATCH  5   // Extract new or changed files of a directory tree as they arrive
+
+/**
+ * @brief Spatial index parameters
+ */
+#define GEO_BITS        16          // The number of bits per axis of the finest cells (about 600 m by 300 m)
+#define GEO_MAX_CELLS   16          // The maximum number of cells covering a query box
+#define EARTH_RADIUS    6371.0088   // The mean radius of the Earth in kilometers
+
+/**
+ * @brief Watch mode parameters
+ */
+#define DEBOUNCE_MS     100         // The quiet period after the last event of a file before it is extracted
+#define RESCAN_SLACK    1000000000  // The margin in nanoseconds for the granularity of file timestamps
+#define WATCH_EVENTS    (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+
+/**
+ * @brief Names of JPEG_ENCODER_*
+ */
+static const char *encoder_names[] = {"unknown", "libjpeg", "photoshop", "camera"};
+
+/**
+ * @brief Per-file result
+ */
+struct Record {
+    char             *Path;     // The path of the file
+    int              Status;    // JPEG_OK if the file was processed successfully
+    uint64_t         Digest;    // The digest of the image payload
+    struct JPEG_Info Info;      // The frame parameters
+    bool             Match;     // Whether the file matches the predicate
+    struct JPEG_GPS  GPS;       // The position and time from the GPS IFD
+    int64_t          Size;      // The size of the file, or -1 if it cannot be opened
+    int64_t          Mtime;     // The modification time of the file in nanoseconds
+};
+
+/**
+ * @brief Cell of a located file, ordered by cell along the Z-order curve
+ * 
+ * Interleaving the bits of the quantized longitude and latitude (as geohash does) maps each cell of every coarser
+ * level to a contiguous range of the finest cells, so a box is searched by a few binary searches on the sorted
+ * array.
+ */
+struct Geo_Entry {
+    uint32_t Cell;      // The interleaved bits of the quantized longitude (even bits) and latitude (odd bits)
+    uint32_t Record;    // The index of the record
+};
+
+/**
+ * @brief Spatial query
+ */
+struct Geo_Query {
+    const char *Text;       // The query as given on the command line
+    bool       Near;        // Whether the query is a radius around a point rather than a box
+    double     South;       // The southern edge of the box in degrees
+    double     West;        // The western edge of the box in degrees, greater than East across the antimeridian
+    double     North;       // The northern edge of the box in degrees
+    double     East;        // The eastern edge of the box in degrees
+    double     Latitude;    // The latitude of the center in degrees
+    double     Longitude;   // The longitude of the center in degrees
+    double     Radius;      // The radius in kilometers
+};
+
+/**
+ * @brief File matching a spatial query
+ */
+struct Geo_Match {
+    size_t Record;      // The index of the record
+    double Distance;    // The distance from the center in kilometers, 0 for a box
+};
+
+/**
+ * @brief Batch job shared by the worker threads
+ */
+struct Batch {
+    int                      Mode;          // One of MODE_*
+    const struct JPEG_Filter *Filter;       // The predicate of MODE_WHERE and MODE_GPS, or NULL
+    bool                     Full_Parse;    // Whether MODE_WHERE evaluates Filter after constructing files in full
+    struct Record            *Records;      // The records, one per path
+    size_t                   Record_Count;  // The number of records
+    atomic_size_t            Next_Record;   // The index of the next record to be processed
+    struct Geo_Entry         *Geo_Index;    // The located records sorted by cell
+    size_t                   Geo_Count;     // The number of located records
+};
+
+/**
+ * @brief Extract the frame parameters, GPS position and predicate of a file from a copy of its header.
+ */
+static void watch_extract(struct Batch *batch, struct Record *rec, int fd) {
+    struct JPEG jpeg = {.Filter = batch->Filter};
+    uint8_t     *buf = NULL;
+    size_t      cap  = 0;
+    size_t      len  = 0;
+    ssize_t     n    = 0;
+    int         ret  = JPEG_NEED_MORE_DATA;
+
+    /* Read up to SOFn, doubling the buffer, with zeroed bytes past the header as the constructors read ahead */
+    while (ret == JPEG_NEED_MORE_DATA && len == cap) {
+        cap = (cap == 0) ? 65536 : cap * 2;
+        buf = realloc(buf, cap + 16);
+
+        while (len < cap && (n = read(fd, buf + len, cap - len)) > 0) {
+            len += n;
+        }
+
+        ret = jpeg_probe(buf, len, &rec->Info);
+    }
+
+    memset(buf + len, 0, 16);
+
+    if (jpeg_header_complete(buf, len)) {
+        jpeg_construct(&jpeg, buf);
+        rec->Match  = jpeg_filter_match(&jpeg);
+        rec->Status = JPEG_OK;
+        jpeg_gps(&jpeg, &rec->GPS);
+        jpeg_free(&jpeg);
+    }
+
+    free(buf);
+}
+
+/**
+ * @brief Map the file into memory and process it according to the mode.
+ */
+static void process(struct Batch *batch, struct Record *rec) {
+    int         fd   = open(rec->Path, O_RDONLY);
+    struct stat st   = {0};
+    uint8_t     *buf = NULL;
+
+    rec->Status = JPEG_ERROR;
+    rec->Size   = -1;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        goto out;
+    }
+
+    rec->Size  = st.st_size;
+    rec->Mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+    if (st.st_size == 0) {
+        goto out;
+    }
+
+    /* A file being watched may be truncated while extracted, which would fault a mapping */
+    if (batch->Mode == MODE_WATCH) {
+        watch_extract(batch, rec, fd);
+        goto out;
+    }
+
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buf == MAP_FAILED) {
+        goto out;
+    }
+
+    switch (batch->Mode) {
+        case MODE_DEDUP: {
+            madvise(buf, st.st_size, MADV_SEQUENTIAL);
+            rec->Status = jpeg_payload_hash(buf, st.st_size, &rec->Digest);
+            break;
+        }
+
+        case MODE_PROBE: {
+            /* Without read-ahead, only the pages holding Marker Segment headers are read */
+            madvise(buf, st.st_size, MADV_RANDOM);
+            rec->Status = jpeg_probe(buf, st.st_size, &rec->Info);
+            break;
+        }
+
+        case MODE_WHERE: {
+            struct JPEG jpeg = {.Filter = batch->Full_Parse ? NULL : batch->Filter};
+
+            /* The predicate is evaluated while the IFDs are constructed, which stops once it is known to be false */
+            madvise(buf, st.st_size, MADV_RANDOM);
+            if (jpeg_header_complete(buf, st.st_size)) {
+                jpeg_construct(&jpeg, buf);
+                rec->Match  = batch->Full_Parse ? jpeg_filter_eval(&jpeg, batch->Filter) : jpeg_filter_match(&jpeg);
+                rec->Status = JPEG_OK;
+                jpeg_free(&jpeg);
+            }
+            break;
+        }
+
+        case MODE_GPS: {
+            struct JPEG jpeg = {.Filter = batch->Filter};
+
+            /* Files without GPS IFD (or not matching the predicate) are dropped after their 0th IFD */
+            madvise(buf, st.st_size, MADV_RANDOM);
+            if (jpeg_header_complete(buf, st.st_size)) {
+                jpeg_construct(&jpeg, buf);
+                if (jpeg_filter_match(&jpeg) && jpeg_gps(&jpeg, &rec->GPS) == JPEG_OK &&
+                    (rec->GPS.Fields & JPEG_GPS_POSITION)) {
+                    rec->Status = JPEG_OK;
+                }
+                jpeg_free(&jpeg);
+            }
+            break;
+        }
+
+        default: break;
+    }
+
+    munmap(buf, st.st_size);
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+static void *worker(void *arg) {
+    struct Batch *batch = arg;
+    size_t       idx    = 0;
+
+    while ((idx = atomic_fetch_add(&batch->Next_Record, 1)) < batch->Record_Count) {
+        process(batch, &(batch->Records[idx]));
+    }
+
+    return NULL;
+}
+
+static int compare_digest(const void *a, const void *b) {
+    const struct Record *ra = a;
+    const struct Record *rb = b;
+
+    /* Files processed successfully come first, then the others by status, so that the order is total */
+    if (ra->Status != rb->Status && (ra->Status == JPEG_OK || rb->Status == JPEG_OK)) {
+        return (ra->Status == JPEG_OK) ? -1 : 1;
+    }
+
+    if (ra->Status != rb->Status) {
+        return (ra->Status > rb->Status) - (ra->Status < rb->Status);
+    }
+
+    return (ra->Digest > rb->Digest) - (ra->Digest < rb->Digest);
+}
+
+/**
+ * @brief Print the groups of files sharing the same image payload, one group per paragraph.
+ */
+static void print_duplicates(struct Batch *batch) {
+    struct Record *recs = batch->Records;
+    size_t        cnt   = batch->Record_Count;
+    size_t        end   = 0;
+
+    qsort(recs, cnt, sizeof(struct Record), compare_digest);
+
+    for (size_t i = 0; i < cnt && recs[i].Status == JPEG_OK; i = end) {
+        for (end = i + 1; end < cnt && recs[end].Status == JPEG_OK && recs[end].Digest == recs[i].Digest; end++);
+
+        if (end - i < 2) {
+            continue;
+        }
+
+        for (size_t j = i; j < end; j++) {
+            printf("%016"PRIx64"  %s\n", recs[j].Digest, recs[j].Path);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Print the frame parameters of each file in input order.
+ */
+static void print_frames(struct Batch *batch) {
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        struct Record    *rec  = &(batch->Records[i]);
+        struct JPEG_Info *info = &(rec->Info);
+        const char       *mode = NULL;
+
+        if (rec->Status != JPEG_OK) {
+            fprintf(stderr, "%s: no frame found\n", rec->Path);
+            continue;
+        }
+
+        mode = info->Lossless ? "lossless" : info->Progressive ? "progressive" : info->Baseline ? "baseline" : "extended";
+
+        printf("%s\t%"PRIu16"\t%"PRIu16"\t%"PRIu8"\t%"PRIu8"\t%s%s\t%s\t%"PRIu8"\t%s\n", rec->Path, info->Width,
+               info->Height, info->Precision, info->Component_Count, mode, info->Arithmetic ? "-arithmetic" : "",
+               info->Subsampling, info->Quality, encoder_names[info->Encoder]);
+    }
+}
+
+/**
+ * @brief Print the paths of the matching files in input order.
+ */
+static void print_matches(struct Batch *batch) {
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        if (batch->Records[i].Status == JPEG_OK && batch->Records[i].Match) {
+            printf("%s\n", batch->Records[i].Path);
+        }
+    }
+}
+
+/**
+ * @brief Print the position, altitude and time of each located file in input order.
+ */
+static void print_positions(struct Batch *batch) {
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        struct JPEG_GPS *gps = &(batch->Records[i].GPS);
+
+        if (batch->Records[i].Status != JPEG_OK) {
+            continue;
+        }
+
+        printf("%s\t%.7f\t%.7f", batch->Records[i].Path, gps->Latitude, gps->Longitude);
+
+        if (gps->Fields & JPEG_GPS_ALTITUDE) {
+            printf("\t%.2f", gps->Altitude);
+        } else {
+            printf("\t-");
+        }
+
+        if ((gps->Fields & JPEG_GPS_DATE) && (gps->Fields & JPEG_GPS_TIME)) {
+            printf("\t%s %02d:%02d:%02d\n", gps->Date, (int)(gps->Time / 3600), (int)(gps->Time / 60) % 60,
+                   (int)gps->Time % 60);
+        } else {
+            printf("\t-\n");
+        }
+    }
+}
+
+/**
+ * @brief Quantize a coordinate into GEO_BITS bits.
+ */
+static uint32_t geo_axis(double deg, double min, double span) {
+    double q = (deg - min) / span * (1 << GEO_BITS);
+
+    return (q < 0) ? 0 : (q >= (1 << GEO_BITS)) ? (1 << GEO_BITS) - 1 : (uint32_t)q;
+}
+
+/**
+ * @brief Interleave the bits of the given quantized longitude and latitude.
+ */
+static uint32_t geo_interleave(uint32_t x, uint32_t y) {
+    uint32_t cell = 0;
+
+    for (int i = 0; i < GEO_BITS; i++) {
+        cell |= ((x >> i) & 1) << (2 * i);
+        cell |= ((y >> i) & 1) << (2 * i + 1);
+    }
+
+    return cell;
+}
+
+/**
+ * @brief Obtain the great-circle distance in kilometers between two points (haversine formula).
+ */
+static double geo_distance(double lat1, double lon1, double lat2, double lon2) {
+    double phi1 = lat1 * M_PI / 180;
+    double phi2 = lat2 * M_PI / 180;
+    double dphi = (lat2 - lat1) * M_PI / 180;
+    double dlam = (lon2 - lon1) * M_PI / 180;
+    double h    = sin(dphi / 2) * sin(dphi / 2) + cos(phi1) * cos(phi2) * sin(dlam / 2) * sin(dlam / 2);
+
+    return 2 * EARTH_RADIUS * asin(sqrt(fmin(h, 1)));
+}
+
+/**
+ * @brief Check whether a position satisfies a query, filling the distance from the center of a radius query.
+ */
+static bool geo_contains(const struct Geo_Query *query, const struct JPEG_GPS *gps, double *dist) {
+    *dist = 0;
+
+    if (query->Near) {
+        *dist = geo_distance(query->Latitude, query->Longitude, gps->Latitude, gps->Longitude);
+        return *dist <= query->Radius;
+    }
+
+    if (gps->Latitude < query->South || gps->Latitude > query->North) {
+        return false;
+    }
+
+    if (query->West <= query->East) {
+        return gps->Longitude >= query->West && gps->Longitude <= query->East;
+    }
+
+    return gps->Longitude >= query->West || gps->Longitude <= query->East;
+}
+
+static int compare_cell(const void *a, const void *b) {
+    const struct Geo_Entry *ea = a;
+    const struct Geo_Entry *eb = b;
+
+    return (ea->Cell > eb->Cell) - (ea->Cell < eb->Cell);
+}
+
+static int compare_match(const void *a, const void *b) {
+    const struct Geo_Match *ma = a;
+    const struct Geo_Match *mb = b;
+
+    if (ma->Distance != mb->Distance) {
+        return (ma->Distance > mb->Distance) ? 1 : -1;
+    }
+
+    return (ma->Record > mb->Record) - (ma->Record < mb->Record);
+}
+
+/**
+ * @brief Index the located records by cell.
+ */
+static void geo_build(struct Batch *batch) {
+    batch->Geo_Index = malloc((batch->Record_Count + 1) * sizeof(struct Geo_Entry));
+    batch->Geo_Count = 0;
+
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        struct JPEG_GPS *gps = &(batch->Records[i].GPS);
+
+        if (batch->Records[i].Status == JPEG_OK) {
+            batch->Geo_Index[batch->Geo_Count].Cell   = geo_interleave(geo_axis(gps->Longitude, -180, 360),
+                                                                       geo_axis(gps->Latitude, -90, 180));
+            batch->Geo_Index[batch->Geo_Count].Record = i;
+            batch->Geo_Count++;
+        }
+    }
+
+    qsort(batch->Geo_Index, batch->Geo_Count, sizeof(struct Geo_Entry), compare_cell);
+}
+
+/**
+ * @brief Collect the records satisfying a query among those whose cells intersect the given box.
+ * 
+ * The box is covered by at most GEO_MAX_CELLS cells of the finest level at which it fits, each of which is a
+ * contiguous range of the index.
+ */
+static size_t geo_scan(const struct Batch *batch, const struct Geo_Query *query, double south, double west,
+                       double north, double east, struct Geo_Match *matches, size_t cnt) {
+    uint32_t x0    = geo_axis(west, -180, 360);
+    uint32_t x1    = geo_axis(east, -180, 360);
+    uint32_t y0    = geo_axis(south, -90, 180);
+    uint32_t y1    = geo_axis(north, -90, 180);
+    int      shift = 0;
+
+    while ((uint64_t)((x1 >> shift) - (x0 >> shift) + 1) * ((y1 >> shift) - (y0 >> shift) + 1) > GEO_MAX_CELLS) {
+        shift++;
+    }
+
+    for (uint32_t cx = x0 >> shift; cx <= x1 >> shift; cx++) {
+        for (uint32_t cy = y0 >> shift; cy <= y1 >> shift; cy++) {
+            uint64_t lo    = (uint64_t)geo_interleave(cx, cy) << (2 * shift);
+            uint64_t hi    = lo + ((uint64_t)1 << (2 * shift));
+            size_t   left  = 0;
+            size_t   right = batch->Geo_Count;
+
+            /* Find the first entry of the cell */
+            while (left < right) {
+                size_t mid = left + (right - left) / 2;
+
+                if (batch->Geo_Index[mid].Cell < lo) {
+                    left = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+
+            /* The cells of both halves of a box split at the antimeridian may overlap, so the box is checked too */
+            for (size_t i = left; i < batch->Geo_Count && batch->Geo_Index[i].Cell < hi; i++) {
+                size_t          rec  = batch->Geo_Index[i].Record;
+                struct JPEG_GPS *gps = &(batch->Records[rec].GPS);
+
+                if (gps->Latitude >= south && gps->Latitude <= north && gps->Longitude >= west &&
+                    gps->Longitude <= east && geo_contains(query, gps, &(matches[cnt].Distance))) {
+                    matches[cnt++].Record = rec;
+                }
+            }
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief Collect the records satisfying a query with the index, nearest first, then in input order.
+ */
+static size_t geo_search(const struct Batch *batch, const struct Geo_Query *query, struct Geo_Match *matches) {
+    double south = query->South;
+    double west  = query->West;
+    double north = query->North;
+    double east  = query->East;
+    size_t cnt   = 0;
+
+    /* Bound a radius query by a box, spanning every longitude if it reaches a pole */
+    if (query->Near) {
+        double dlat = query->Radius / EARTH_RADIUS * 180 / M_PI + 1e-6;
+        double dlon = 180;
+
+        south = query->Latitude - dlat;
+        north = query->Latitude + dlat;
+
+        if (south > -90 && north < 90 && query->Radius / EARTH_RADIUS < M_PI / 2) {
+            dlon = asin(fmin(sin(query->Radius / EARTH_RADIUS) / cos(query->Latitude * M_PI / 180), 1)) * 180 / M_PI + 1e-6;
+        }
+
+        south = fmax(south, -90);
+        north = fmin(north, 90);
+        west  = (dlon >= 180) ? -180 : query->Longitude - dlon;
+        east  = (dlon >= 180) ? 180 : query->Longitude + dlon;
+        west  = (west < -180) ? west + 360 : west;
+        east  = (east > 180) ? east - 360 : east;
+    }
+
+    /* Split a box crossing the antimeridian */
+    if (west <= east) {
+        cnt = geo_scan(batch, query, south, west, north, east, matches, cnt);
+    } else {
+        cnt = geo_scan(batch, query, south, west, north, 180, matches, cnt);
+        cnt = geo_scan(batch, query, south, -180, north, east, matches, cnt);
+    }
+
+    qsort(matches, cnt, sizeof(struct Geo_Match), compare_match);
+
+    return cnt;
+}
+
+/**
+ * @brief Collect the records satisfying a query by checking every located record.
+ */
+static size_t geo_linear(const struct Batch *batch, const struct Geo_Query *query, struct Geo_Match *matches) {
+    size_t cnt = 0;
+
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        if (batch->Records[i].Status == JPEG_OK &&
+            geo_contains(query, &(batch->Records[i].GPS), &(matches[cnt].Distance))) {
+            matches[cnt++].Record = i;
+        }
+    }
+
+    qsort(matches, cnt, sizeof(struct Geo_Match), compare_match);
+
+    return cnt;
+}
+
+/**
+ * @brief Print the files satisfying each query, one query per paragraph.
+ */
+static void print_queries(struct Batch *batch, const struct Geo_Query *queries, size_t query_cnt) {
+    struct Geo_Match *matches = malloc((batch->Record_Count + 1) * sizeof(struct Geo_Match));
+
+    for (size_t q = 0; q < query_cnt; q++) {
+        size_t cnt = geo_search(batch, &queries[q], matches);
+
+        printf("# %s\n", queries[q].Text);
+
+        for (size_t i = 0; i < cnt; i++) {
+            struct Record *rec = &(batch->Records[matches[i].Record]);
+
+            if (queries[q].Near) {
+                printf("%s\t%.7f\t%.7f\t%.3f\n", rec->Path, rec->GPS.Latitude, rec->GPS.Longitude, matches[i].Distance);
+            } else {
+                printf("%s\t%.7f\t%.7f\n", rec->Path, rec->GPS.Latitude, rec->GPS.Longitude);
+            }
+        }
+        printf("\n");
+    }
+
+    free(matches);
+}
+
+/**
+ * @brief Parse a spatial query of the form "S,W,N,E" or "LAT,LON,KM".
+ */
+static bool parse_query(const char *text, bool near, struct Geo_Query *query) {
+    char end = '\0';
+
+    memset(query, 0, sizeof(struct Geo_Query));
+    query->Text = text;
+    query->Near = near;
+
+    if (near) {
+        return sscanf(text, "%lf,%lf,%lf%c", &query->Latitude, &query->Longitude, &query->Radius, &end) == 3 &&
+               fabs(query->Latitude) <= 90 && fabs(query->Longitude) <= 180 && query->Radius > 0;
+    }
+
+    return sscanf(text, "%lf,%lf,%lf,%lf%c", &query->South, &query->West, &query->North, &query->East, &end) == 4 &&
+           query->South >= -90 && query->North <= 90 && query->South <= query->North &&
+           fabs(query->West) <= 180 && fabs(query->East) <= 180;
+}
+
+/**
+ * @brief Process every record with the given number of worker threads.
+ */
+static void run(struct Batch *batch, long thread_cnt) {
+    pthread_t threads[MAX_THREADS] = {0};
+
+    atomic_store(&batch->Next_Record, 0);
+
+    for (long i = 0; i < thread_cnt; i++) {
+        pthread_create(&threads[i], NULL, worker, batch);
+    }
+
+    for (long i = 0; i < thread_cnt; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+/**
+ * @brief Compare the throughput of evaluating the predicate after constructing every file in full with that of
+ *        evaluating it during the construction.
+ * 
+ * After a warm-up pass bringing the files into the page cache, the two scans alternate so that neither benefits
+ * from running last.
+ * 
+ * @return true if both scans matched the same files, false otherwise
+ */
+static bool bench(struct Batch *batch, long thread_cnt) {
+    const char      *names[2]  = {"full parse", "pushdown"};
+    size_t          matched[2] = {0};
+    double          secs[2]    = {0};
+    bool            consistent = true;
+    struct timespec t0         = {0};
+    struct timespec t1         = {0};
+
+    batch->Full_Parse = true;
+    run(batch, thread_cnt);
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < 2; i++) {
+            int pass = (round + i) % 2;
+
+            batch->Full_Parse = (pass == 0);
+
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            run(batch, thread_cnt);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+
+            secs[pass]    += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            matched[pass]  = 0;
+            for (size_t r = 0; r < batch->Record_Count; r++) {
+                matched[pass] += (batch->Records[r].Status == JPEG_OK && batch->Records[r].Match);
+            }
+        }
+
+        consistent = consistent && (matched[0] == matched[1]);
+    }
+
+    batch->Full_Parse = false;
+
+    printf("┌────────────┬────────────┬────────────┬────────────┐\n");
+    printf("│ Scan       │   Files    │  Matched   │  Files/s   │\n");
+    printf("├────────────┼────────────┼────────────┼────────────┤\n");
+
+    for (int pass = 0; pass < 2; pass++) {
+        printf("│ %-10s │ %-10zu │ %-10zu │ %-10.0f │\n", names[pass], batch->Record_Count, matched[pass],
+               BENCH_ROUNDS * batch->Record_Count / secs[pass]);
+    }
+
+    printf("└────────────┴────────────┴────────────┴────────────┘\n");
+
+    if (!consistent) {
+        printf("The scans matched different files\n");
+    }
+
+    return consistent;
+}
+
+/**
+ * @brief Compare the throughput of answering the queries by checking every located record with that of the index.
+ */
+static void bench_queries(struct Batch *batch, const struct Geo_Query *queries, size_t query_cnt) {
+    const char       *names[2] = {"linear", "index"};
+    struct Geo_Match *matches  = malloc((batch->Record_Count + 1) * sizeof(struct Geo_Match));
+    struct timespec  t0        = {0};
+    struct timespec  t1        = {0};
+
+    printf("Indexed %zu of %zu files\n", batch->Geo_Count, batch->Record_Count);
+    printf("┌────────────┬────────────┬────────────┬────────────┐\n");
+    printf("│ Search     │  Queries   │  Matched   │ Queries/s  │\n");
+    printf("├────────────┼────────────┼────────────┼────────────┤\n");
+
+    for (int pass = 0; pass < 2; pass++) {
+        size_t searched = 0;
+        size_t matched  = 0;
+        double secs     = 0;
+
+        /* Repeat the queries for at least a second */
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        do {
+            matched = 0;
+            for (size_t q = 0; q < query_cnt; q++) {
+                matched += (pass == 0) ? geo_linear(batch, &queries[q], matches) : geo_search(batch, &queries[q], matches);
+            }
+            searched += query_cnt;
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        } while (secs < 1);
+
+        printf("│ %-10s │ %-10zu │ %-10zu │ %-10.0f │\n", names[pass], query_cnt, matched, searched / secs);
+    }
+
+    printf("└────────────┴────────────┴────────────┴────────────┘\n");
+
+    free(matches);
+}
+
+/**
+ * @brief File under the watched directory tree
+ */
+struct Watch_Entry {
+    char    *Path;      // The path of the file
+    int64_t Size;       // The size of the file when last extracted, or -1 if never
+    int64_t Mtime;      // The modification time of the file when last extracted, in nanoseconds
+    int64_t Due;        // The monotonic time at which the file is to be extracted, if pending
+    bool    Pending;    // Whether the file waits for its events to settle
+};
+
+/**
+ * @brief Watched directory tree, its files and the results store
+ * 
+ * Every event of a file pushes its due time back by the debounce period, so a file written in several passes or
+ * copied then renamed is extracted once. The files are kept in an open-addressing hash table by path, with the size
+ * and modification time of their last extraction, which is also what the store records.
+ */
+struct Watch {
+    int                Inotify;         // The inotify instance
+    const char         *Root;           // The root of the tree, without a trailing slash
+    char               **Dirs;          // The paths of the watched directories, by watch descriptor
+    size_t             Dir_Count;       // The capacity of Dirs
+    struct Watch_Entry **Table;         // The files by path
+    size_t             Table_Size;      // The capacity of Table, a power of 2
+    size_t             Entry_Count;     // The number of files
+    struct Watch_Entry **Pending;       // The files waiting for their events to settle
+    size_t             Pending_Count;   // The number of pending files
+    size_t             Pending_Size;    // The capacity of Pending
+    int                Store;           // The results store opened for appending, or -1
+    dev_t              Store_Dev;       // The device of the store, to skip it if it lies within the tree
+    ino_t              Store_Ino;       // The inode of the store
+    int64_t            Debounce;        // The quiet period in nanoseconds
+    int64_t            Synced;          // The wall-clock time before the last read draining the events without overflow
+};
+
+static int64_t now_ns(clockid_t clock) {
+    struct timespec ts = {0};
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Hash the given path (FNV-1a) into a slot of the hash table.
+ */
+static size_t watch_hash(const struct Watch *watch, const char *path) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (const char *c = path; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 0x100000001B3ULL;
+    }
+
+    return hash & (watch->Table_Size - 1);
+}
+
+/**
+ * @brief Find the slot of the given path (linear probing), or the empty slot where it belongs.
+ */
+static size_t watch_slot(const struct Watch *watch, const char *path) {
+    size_t idx = 0;
+
+    for (idx = watch_hash(watch, path); watch->Table[idx] != NULL; idx = (idx + 1) & (watch->Table_Size - 1)) {
+        if (strcmp(watch->Table[idx]->Path, path) == 0) {
+            break;
+        }
+    }
+
+    return idx;
+}
+
+/**
+ * @brief Find the file of the given path, adding it if asked to.
+ */
+static struct Watch_Entry *watch_find(struct Watch *watch, const char *path, bool add) {
+    size_t idx = watch_slot(watch, path);
+
+    if (watch->Table[idx] != NULL || !add) {
+        return watch->Table[idx];
+    }
+
+    /* Rehash at half load so that probes stay short, moving the entries as the pending list points to them */
+    if (2 * (watch->Entry_Count + 1) > watch->Table_Size) {
+        struct Watch_Entry **old = watch->Table;
+        size_t             size  = watch->Table_Size;
+
+        watch->Table_Size = size * 2;
+        watch->Table      = calloc(watch->Table_Size, sizeof(struct Watch_Entry *));
+
+        for (size_t i = 0; i < size; i++) {
+            if (old[i] != NULL) {
+                watch->Table[watch_slot(watch, old[i]->Path)] = old[i];
+            }
+        }
+
+        free(old);
+        idx = watch_slot(watch, path);
+    }
+
+    watch->Table[idx]        = calloc(1, sizeof(struct Watch_Entry));
+    watch->Table[idx]->Path  = strdup(path);
+    watch->Table[idx]->Size  = -1;
+    watch->Entry_Count      += 1;
+
+    return watch->Table[idx];
+}
+
+/**
+ * @brief Remove the file of the given path, and from the pending files, shifting back the entries probed past it.
+ */
+static void watch_remove(struct Watch *watch, const char *path) {
+    size_t mask = watch->Table_Size - 1;
+    size_t hole = watch_slot(watch, path);
+    size_t home = 0;
+
+    if (watch->Table[hole] == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; watch->Table[hole]->Pending && i < watch->Pending_Count; i++) {
+        if (watch->Pending[i] == watch->Table[hole]) {
+            watch->Pending[i] = watch->Pending[--watch->Pending_Count];
+            break;
+        }
+    }
+
+    free(watch->Table[hole]->Path);
+    free(watch->Table[hole]);
+    watch->Table[hole]  = NULL;
+    watch->Entry_Count -= 1;
+
+    /* Move each following entry of the run into the hole unless its home slot lies between the hole and itself */
+    for (size_t idx = (hole + 1) & mask; watch->Table[idx] != NULL; idx = (idx + 1) & mask) {
+        home = watch_hash(watch, watch->Table[idx]->Path);
+        if (((idx - home) & mask) >= ((idx - hole) & mask)) {
+            watch->Table[hole] = watch->Table[idx];
+            watch->Table[idx]  = NULL;
+            hole               = idx;
+        }
+    }
+}
+
+/**
+ * @brief Schedule the extraction of a file at the given time, postponing it if already pending.
+ */
+static void watch_touch(struct Watch *watch, const char *path, int64_t due) {
+    struct Watch_Entry *entry = watch_find(watch, path, true);
+
+    if (!entry->Pending) {
+        if (watch->Pending_Count == watch->Pending_Size) {
+            watch->Pending_Size = (watch->Pending_Size == 0) ? 64 : watch->Pending_Size * 2;
+            watch->Pending      = realloc(watch->Pending, watch->Pending_Size * sizeof(struct Watch_Entry *));
+        }
+
+        watch->Pending[watch->Pending_Count++] = entry;
+        entry->Pending                          = true;
+    }
+
+    entry->Due = due;
+}
+
+/**
+ * @brief Watch a directory and its subdirectories, and schedule the files that are new, that differ in size or
+ *        modification time from their last extraction, or whose status changed at or after `since`.
+ */
+static void watch_dir(struct Watch *watch, const char *path, int64_t since) {
+    int           wd   = inotify_add_watch(watch->Inotify, path, WATCH_EVENTS | IN_ONLYDIR);
+    DIR           *dir = NULL;
+    struct dirent *ent = NULL;
+    int64_t       due  = now_ns(CLOCK_MONOTONIC) + watch->Debounce;
+
+    if (wd < 0) {
+        fprintf(stderr, "Cannot watch %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    /* A directory watched again (on a rescan, or moved within the tree) keeps its watch descriptor */
+    if ((size_t)wd >= watch->Dir_Count) {
+        size_t count = watch->Dir_Count;
+
+        watch->Dir_Count = (wd + 1 > 2 * (int)count) ? wd + 1 : 2 * count;
+        watch->Dirs      = realloc(watch->Dirs, watch->Dir_Count * sizeof(char *));
+        memset(watch->Dirs + count, 0, (watch->Dir_Count - count) * sizeof(char *));
+    }
+
+    if (watch->Dirs[wd] == NULL || strcmp(watch->Dirs[wd], path) != 0) {
+        free(watch->Dirs[wd]);
+        watch->Dirs[wd] = strdup(path);
+    }
+
+    if ((dir = opendir(path)) == NULL) {
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        struct stat        st     = {0};
+        struct Watch_Entry *entry = NULL;
+        size_t             len    = strlen(path) + strlen(ent->d_name) + 2;
+        char               *child = NULL;
+
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0 ||
+            fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        child = malloc(len);
+        snprintf(child, len, "%s/%s", path, ent->d_name);
+
+        if (S_ISDIR(st.st_mode)) {
+            watch_dir(watch, child, since);
+        } else if (S_ISREG(st.st_mode) && !(st.st_dev == watch->Store_Dev && st.st_ino == watch->Store_Ino)) {
+            entry = watch_find(watch, child, false);
+            if (entry == NULL || entry->Size != st.st_size ||
+                entry->Mtime != st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec ||
+                st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec >= since) {
+                watch_touch(watch, child, due);
+            }
+        }
+
+        free(child);
+    }
+
+    closedir(dir);
+}
+
+/**
+ * @brief Append records to the store and stdout, in a single write so that concurrent readers never see half of one.
+ */
+static void watch_emit(struct Watch *watch, const char *out, size_t len) {
+    if (len == 0) {
+        return;
+    }
+
+    if (watch->Store >= 0 && write(watch->Store, out, len) != (ssize_t)len) {
+        fprintf(stderr, "Cannot append to the store: %s\n", strerror(errno));
+    }
+    fwrite(out, 1, len, stdout);
+    fflush(stdout);
+}
+
+/**
+ * @brief Print the record of a file that is gone, so that the store forgets it.
+ */
+static void watch_print_deleted(FILE *fd, const char *path) {
+    fprintf(fd, "0\t-1\tdeleted\t0\t0\t0\t-\t-\t0\t%s\n", path);
+}
+
+/**
+ * @brief Forget the files of the given path, or under it for a directory, recording those extracted as deleted.
+ */
+static void watch_forget(struct Watch *watch, const char *path, bool is_dir) {
+    struct Watch_Entry *entry  = watch_find(watch, path, false);
+    size_t             len     = strlen(path);
+    char               **paths = NULL;
+    size_t             cnt     = 0;
+    char               *out    = NULL;
+    size_t             size    = 0;
+    FILE               *fd     = NULL;
+
+    if (!is_dir && entry == NULL) {
+        return;
+    }
+
+    /* Collect the paths first, as removing an entry moves the others within the table */
+    if (is_dir) {
+        paths = malloc((watch->Entry_Count + 1) * sizeof(char *));
+        for (size_t i = 0; i < watch->Table_Size; i++) {
+            if (watch->Table[i] != NULL && strncmp(watch->Table[i]->Path, path, len) == 0 &&
+                watch->Table[i]->Path[len] == '/') {
+                paths[cnt++] = watch->Table[i]->Path;
+            }
+        }
+    } else {
+        paths    = malloc(sizeof(char *));
+        paths[0] = entry->Path;
+        cnt      = 1;
+    }
+
+    fd = open_memstream(&out, &size);
+    for (size_t i = 0; i < cnt; i++) {
+        if (watch_find(watch, paths[i], false)->Size >= 0) {
+            watch_print_deleted(fd, paths[i]);
+        }
+        watch_remove(watch, paths[i]);
+    }
+    fclose(fd);
+
+    watch_emit(watch, out, size);
+
+    free(out);
+    free(paths);
+}
+
+/**
+ * @brief Load the last record of each file from the store, so that unchanged files are not extracted again.
+ * 
+ * Each line is `MTIME SIZE STATUS WIDTH HEIGHT QUALITY LATITUDE LONGITUDE MATCH PATH`, separated by tabs, with the
+ * path last as it may contain tabs itself. A file extracted several times has several lines, the last one winning,
+ * and a file that is gone has a `deleted` line with a negative size.
+ */
+static void watch_load(struct Watch *watch, FILE *fd) {
+    char    *line = NULL;
+    size_t  cap   = 0;
+    ssize_t len   = 0;
+
+    while ((len = getline(&line, &cap, fd)) > 0) {
+        struct Watch_Entry *entry = NULL;
+        char               *path  = line;
+        int64_t            mtime  = 0;
+        int64_t            size   = 0;
+
+        if (line[len - 1] != '\n') {
+            break;  // A line cut short by a crash while appending
+        }
+        line[len - 1] = '\0';
+
+        for (int i = 0; i < 9 && path != NULL; i++) {
+            path = strchr(path, '\t');
+            path = (path != NULL) ? path + 1 : NULL;
+        }
+
+        if (path == NULL || *path == '\0' || sscanf(line, "%"SCNd64"\t%"SCNd64"\t", &mtime, &size) != 2) {
+            continue;
+        }
+
+        if (size < 0) {
+            watch_remove(watch, path);
+            continue;
+        }
+
+        entry        = watch_find(watch, path, true);
+        entry->Mtime = mtime;
+        entry->Size  = size;
+    }
+
+    free(line);
+}
+
+/**
+ * @brief Extract the pending files whose events have settled, and append their records to the store and stdout.
+ */
+static void watch_drain(struct Watch *watch, struct Batch *batch, long thread_cnt) {
+    int64_t now  = now_ns(CLOCK_MONOTONIC);
+    size_t  kept = 0;
+    char    *out = NULL;
+    size_t  len  = 0;
+    FILE    *fd  = NULL;
+
+    batch->Record_Count = 0;
+    batch->Records      = realloc(batch->Records, (watch->Pending_Count + 1) * sizeof(struct Record));
+
+    for (size_t i = 0; i < watch->Pending_Count; i++) {
+        struct Watch_Entry *entry = watch->Pending[i];
+
+        if (entry->Due > now) {
+            watch->Pending[kept++] = entry;
+            continue;
+        }
+
+        entry->Pending = false;
+        memset(&(batch->Records[batch->Record_Count]), 0, sizeof(struct Record));
+        batch->Records[batch->Record_Count++].Path = entry->Path;
+    }
+
+    watch->Pending_Count = kept;
+
+    if (batch->Record_Count == 0) {
+        return;
+    }
+
+    run(batch, (thread_cnt < (long)batch->Record_Count) ? thread_cnt : (long)batch->Record_Count);
+
+    /* Records of a batch go to the store in a single append, so that concurrent readers never see half of one */
+    fd = open_memstream(&out, &len);
+    for (size_t i = 0; i < batch->Record_Count; i++) {
+        struct Record      *rec   = &(batch->Records[i]);
+        struct Watch_Entry *entry = watch_find(watch, rec->Path, false);
+
+        /* Files deleted or renamed away before their extraction, such as the temporary names of uploads */
+        if (rec->Size < 0) {
+            if (entry->Size >= 0) {
+                watch_print_deleted(fd, rec->Path);
+            }
+            rec->Path = NULL;
+            watch_remove(watch, entry->Path);
+            continue;
+        }
+
+        entry->Size  = rec->Size;
+        entry->Mtime = rec->Mtime;
+
+        fprintf(fd, "%"PRId64"\t%"PRId64"\t%s\t%"PRIu16"\t%"PRIu16"\t%"PRIu8"\t", rec->Mtime, rec->Size,
+                (rec->Status == JPEG_OK) ? "ok" : "error", rec->Info.Width, rec->Info.Height, rec->Info.Quality);
+        if (rec->GPS.Fields & JPEG_GPS_POSITION) {
+            fprintf(fd, "%.6f\t%.6f\t", rec->GPS.Latitude, rec->GPS.Longitude);
+        } else {
+            fprintf(fd, "-\t-\t");
+        }
+        fprintf(fd, "%d\t%s\n", rec->Status == JPEG_OK && rec->Match, rec->Path);
+    }
+    fclose(fd);
+
+    watch_emit(watch, out, len);
+
+    free(out);
+}
+
+/**
+ * @brief Extract the files of a directory tree as they are written or moved into it, until interrupted.
+ * 
+ * The tree is first compared with the store, so that only the files added or changed since the last run are
+ * extracted. If the event queue overflows, the tree is walked again, but only its files that differ from their last
+ * extraction, or whose status changed since the last complete read of events, are extracted. Files deleted or moved
+ * away are forgotten, with a `deleted` record.
+ */
+static int watch_run(struct Batch *batch, const char *root, const char *store, long debounce_ms, long thread_cnt) {
+    struct Watch  watch         = {.Inotify = inotify_init1(IN_CLOEXEC), .Store = -1, .Table_Size = 1024};
+    char          *path         = strdup(root);
+    size_t        len           = strlen(path);
+    char          events[65536] = {0};
+    struct pollfd pfd           = {0};
+
+    while (len > 1 && path[len - 1] == '/') {
+        path[--len] = '\0';
+    }
+
+    watch.Root     = path;
+    watch.Table    = calloc(watch.Table_Size, sizeof(struct Watch_Entry *));
+    watch.Debounce = debounce_ms * 1000000LL;
+
+    if (watch.Inotify < 0) {
+        fprintf(stderr, "Cannot initialize inotify: %s\n", strerror(errno));
+        goto out;
+    }
+
+    if (inotify_add_watch(watch.Inotify, path, WATCH_EVENTS | IN_ONLYDIR) < 0) {
+        fprintf(stderr, "Cannot watch %s: %s\n", path, strerror(errno));
+        goto out;
+    }
+
+    if (store != NULL) {
+        struct stat st = {0};
+        FILE        *fd = fopen(store, "r");
+
+        if (fd != NULL) {
+            watch_load(&watch, fd);
+            fclose(fd);
+        }
+
+        watch.Store = open(store, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (watch.Store < 0 || fstat(watch.Store, &st) != 0) {
+            fprintf(stderr, "Cannot open the store %s: %s\n", store, strerror(errno));
+            goto out;
+        }
+
+        watch.Store_Dev = st.st_dev;
+        watch.Store_Ino = st.st_ino;
+    }
+
+    /* Catch up with the files changed while not watching */
+    watch.Synced = now_ns(CLOCK_REALTIME);
+    watch_dir(&watch, watch.Root, INT64_MAX);
+
+    pfd.fd     = watch.Inotify;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        int64_t now      = now_ns(CLOCK_MONOTONIC);
+        int64_t due      = INT64_MAX;
+        int64_t synced   = 0;
+        int     timeout  = -1;
+        int     avail    = 0;
+        bool    overflow = false;
+        ssize_t n        = 0;
+
+        watch_drain(&watch, batch, thread_cnt);
+
+        for (size_t i = 0; i < watch.Pending_Count; i++) {
+            due = (watch.Pending[i]->Due < due) ? watch.Pending[i]->Due : due;
+        }
+        if (due != INT64_MAX) {
+            timeout = (due > now) ? (int)((due - now + 999999) / 1000000) : 0;
+        }
+
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+
+        /* Events up to this time are complete if the read drains the queue without overflow */
+        synced = now_ns(CLOCK_REALTIME);
+        if ((n = read(watch.Inotify, events, sizeof(events))) <= 0) {
+            if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                fprintf(stderr, "Cannot read events: %s\n", strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        now = now_ns(CLOCK_MONOTONIC);
+        for (ssize_t ofst = 0; ofst < n; ofst += sizeof(struct inotify_event) + ((struct inotify_event *)&events[ofst])->len) {
+            struct inotify_event *ev    = (struct inotify_event *)&events[ofst];
+            const char           *dir   = (ev->wd >= 0 && (size_t)ev->wd < watch.Dir_Count) ? watch.Dirs[ev->wd] : NULL;
+            size_t               size   = 0;
+            char                 *child = NULL;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+
+            if (ev->mask & IN_IGNORED) {
+                if (dir != NULL) {
+                    free(watch.Dirs[ev->wd]);
+                    watch.Dirs[ev->wd] = NULL;
+                }
+                continue;
+            }
+
+            if (dir == NULL || ev->len == 0) {
+                continue;
+            }
+
+            size  = strlen(dir) + strlen(ev->name) + 2;
+            child = malloc(size);
+            snprintf(child, size, "%s/%s", dir, ev->name);
+
+            /* A directory moved within the tree is forgotten under its old path, and walked under the new one */
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                watch_forget(&watch, child, ev->mask & IN_ISDIR);
+            } else if (ev->mask & IN_ISDIR) {
+                watch_dir(&watch, child, INT64_MAX);
+            } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                watch_touch(&watch, child, now + watch.Debounce);
+            }
+
+            free(child);
+        }
+
+        /* Events were lost: walk the tree again, extracting what changed since the last complete read */
+        if (overflow) {
+            fprintf(stderr, "Event queue overflowed, rescanning %s\n", watch.Root);
+            watch_dir(&watch, watch.Root, watch.Synced - RESCAN_SLACK);
+        } else if (ioctl(watch.Inotify, FIONREAD, &avail) == 0 && avail == 0) {
+            watch.Synced = synced;
+        }
+    }
+
+out:
+    for (size_t i = 0; i < watch.Table_Size; i++) {
+        if (watch.Table[i] != NULL) {
+            free(watch.Table[i]->Path);
+            free(watch.Table[i]);
+        }
+    }
+    for (size_t i = 0; i < watch.Dir_Count; i++) {
+        free(watch.Dirs[i]);
+    }
+    free(watch.Table);
+    free(watch.Dirs);
+    free(watch.Pending);
+    free(path);
+    if (watch.Inotify >= 0) {
+        close(watch.Inotify);
+    }
+    if (watch.Store >= 0) {
+        close(watch.Store);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Read paths, one per line, from the given stream.
+ */
+static void read_paths(struct Batch *batch, FILE *fd) {
+    char    *line = NULL;
+    size_t  cap   = 0;
+    size_t  max   = 0;
+    ssize_t len   = 0;
+
+    while ((len = getline(&line, &cap, fd)) > 0) {
+        if (line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+
+        if (len == 0) {
+            continue;
+        }
+
+        if (batch->Record_Count == max) {
+            max = (max == 0) ? 1024 : max * 2;
+            batch->Records = realloc(batch->Records, max * sizeof(struct Record));
+        }
+
+        memset(&(batch->Records[batch->Record_Count]), 0, sizeof(struct Record));
+        batch->Records[batch->Record_Count++].Path = strdup(line);
+    }
+
+    free(line);
+}
+
+int main(int argc, char *argv[]) {
+    struct Batch       batch                = {0};
+    struct JPEG_Filter *filter              = NULL;
+    struct Geo_Query   queries[MAX_QUERIES] = {0};
+    size_t             query_cnt            = 0;
+    long               thread_cnt           = sysconf(_SC_NPROCESSORS_ONLN);
+    bool               bench_mode           = false;
+    bool               gps_mode             = false;
+    const char         *watch_root          = NULL;
+    const char         *store               = NULL;
+    long               debounce             = DEBOUNCE_MS;
+    int                ret                  = 0;
+    int                arg                  = 1;
+
+    /* Parse options */
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "--dedup") == 0) {
+            batch.Mode = MODE_DEDUP;
+        } else if (strcmp(argv[arg], "--probe") == 0) {
+            batch.Mode = MODE_PROBE;
+        } else if (strcmp(argv[arg], "--where") == 0 && arg + 1 < argc) {
+            batch.Mode = MODE_WHERE;
+            filter     = jpeg_filter_compile(argv[++arg]);
+            if (filter == NULL) {
+                return 1;
+            }
+        } else if (strcmp(argv[arg], "--gps") == 0) {
+            gps_mode = true;
+        } else if ((strcmp(argv[arg], "--bbox") == 0 || strcmp(argv[arg], "--near") == 0) && arg + 1 < argc) {
+            gps_mode = true;
+            if (query_cnt == MAX_QUERIES || !parse_query(argv[arg + 1], argv[arg][2] == 'n', &queries[query_cnt++])) {
+                fprintf(stderr, "Invalid query: %s %s\n", argv[arg], argv[arg + 1]);
+                jpeg_filter_free(filter);
+                return 1;
+            }
+            arg++;
+        } else if (strcmp(argv[arg], "--watch") == 0 && arg + 1 < argc) {
+            watch_root = argv[++arg];
+        } else if (strcmp(argv[arg], "--store") == 0 && arg + 1 < argc) {
+            store = argv[++arg];
+        } else if (strcmp(argv[arg], "--debounce") == 0 && arg + 1 < argc) {
+            debounce = atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "--bench") == 0) {
+            bench_mode = true;
+        } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            thread_cnt = atol(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+
+    /* Files are dropped as soon as they are known to have no GPS IFD, unless a predicate is given */
+    if (gps_mode) {
+        batch.Mode = MODE_GPS;
+        if (filter == NULL) {
+            filter = jpeg_filter_compile("has GPS");
+        }
+    }
+
+    /* Files are constructed in full unless a predicate is given */
+    if (watch_root != NULL) {
+        if (gps_mode || bench_mode || (batch.Mode != 0 && batch.Mode != MODE_WHERE)) {
+            fprintf(stderr, "--watch cannot be combined with --dedup, --probe, --gps or --bench\n");
+            jpeg_filter_free(filter);
+            return 1;
+        }
+        batch.Mode = MODE_WATCH;
+    }
+
+    if (batch.Mode == 0) {
+        printf("Usage: batch --dedup [-j <THREADS>] [<FILE_NAME>...]\n");
+        printf("       batch --probe [-j <THREADS>] [<FILE_NAME>...]\n");
+        printf("       batch --where <PREDICATE> [--bench] [-j <THREADS>] [<FILE_NAME>...]\n");
+        printf("       batch --gps [--bbox <S,W,N,E>]... [--near <LAT,LON,KM>]... [--where <PREDICATE>] [--bench]\n");
+        printf("             [-j <THREADS>] [<FILE_NAME>...]\n");
+        printf("       batch --watch <DIR> [--store <FILE>] [--debounce <MS>] [--where <PREDICATE>] [-j <THREADS>]\n");
+        printf("       Paths are read from stdin, one per line, if none is given.\n");
+        return 1;
+    }
+
+    batch.Filter = filter;
+    thread_cnt   = (thread_cnt < 1) ? 1 : (thread_cnt > MAX_THREADS) ? MAX_THREADS : thread_cnt;
+
+    /* Watch until interrupted, the records pointing to the paths held by the watch */
+    if (batch.Mode == MODE_WATCH) {
+        ret = watch_run(&batch, watch_root, store, (debounce < 0) ? 0 : debounce, thread_cnt);
+        free(batch.Records);
+        jpeg_filter_free(filter);
+        return ret;
+    }
+
+    /* Collect paths */
+    if (arg < argc) {
+        batch.Record_Count = argc - arg;
+        batch.Records      = calloc(batch.Record_Count, sizeof(struct Record));
+        for (size_t i = 0; i < batch.Record_Count; i++) {
+            batch.Records[i].Path = strdup(argv[arg + i]);
+        }
+    } else {
+        read_paths(&batch, stdin);
+    }
+
+    /* Process files in parallel */
+    if (bench_mode && batch.Mode == MODE_WHERE) {
+        ret = bench(&batch, thread_cnt) ? 0 : 1;
+    } else {
+        run(&batch, thread_cnt);
+    }
+
+    /* Index the located files once for every query */
+    if (batch.Mode == MODE_GPS && query_cnt != 0) {
+        geo_build(&batch);
+    }
+
+    switch (bench_mode ? 0 : batch.Mode) {
+        case MODE_DEDUP: print_duplicates(&batch); break;
+        case MODE_PROBE: print_frames(&batch); break;
+        case MODE_WHERE: print_matches(&batch); break;
+        case MODE_GPS: {
+            if (query_cnt != 0) {
+                print_queries(&batch, queries, query_cnt);
+            } else {
+                print_positions(&batch);
+            }
+            break;
+        }
+        default: break;
+    }
+
+    if (bench_mode && batch.Mode == MODE_GPS && query_cnt != 0) {
+        bench_queries(&batch, queries, query_cnt);
+    }
+
+    /* Free the dynamically allocated memory */
+    for (size_t i = 0; i < batch.Record_Count; i++) {
+        free(batch.Records[i].Path);
+    }
+    free(batch.Records);
+    free(batch.Geo_Index);
+    jpeg_filter_free(filter);
+
+    return ret;
+}
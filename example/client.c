@@ -0,0 +1,366 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+#include "daemon.h"
+
+#define DEPTH       64      // The number of requests in flight by default
+#define WRITE_LEN   65536   // The number of bytes of requests written at once
+
+/**
+ * @brief Requests of a run, shared by the writer thread and the reader
+ */
+struct Run {
+    int             Socket;         // The connected socket
+    char            **Paths;        // The paths, requested in turn
+    size_t          Path_Count;     // The number of paths
+    size_t          Request_Count;  // The number of requests, each path being requested repeatedly
+    size_t          Depth;          // The maximum number of requests in flight
+    struct timespec *Sent;          // The time each request was written, indexed by id
+    pthread_mutex_t Lock;           // Guards `In_Flight` and `Stopped`
+    pthread_cond_t  Room;           // Signaled when a response frees room for a request
+    size_t          In_Flight;      // The number of requests written but not answered
+    bool            Stopped;        // Whether the responses are no longer read
+};
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static bool read_full(int fd, void *buf, size_t len) {
+    uint8_t *ptr = buf;
+    ssize_t n    = 0;
+
+    while (len != 0) {
+        n = read(fd, ptr, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static bool write_full(int fd, const void *buf, size_t len) {
+    const uint8_t *ptr = buf;
+    ssize_t       n    = 0;
+
+    while (len != 0) {
+        n = write(fd, ptr, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write the requests, batching those that fit in the window into a single write.
+ */
+static void *writer_main(void *arg) {
+    struct Run *run = arg;
+    uint8_t    *buf = malloc(WRITE_LEN + sizeof(struct Request_Header) + DAEMON_MAX_PATH);
+    size_t     len  = 0;
+    size_t     room = 0;
+
+    for (size_t id = 0; id < run->Request_Count;) {
+        /* Wait for room in the window */
+        pthread_mutex_lock(&run->Lock);
+        while (run->In_Flight >= run->Depth && !run->Stopped) {
+            pthread_cond_wait(&run->Room, &run->Lock);
+        }
+        if (run->Stopped) {
+            pthread_mutex_unlock(&run->Lock);
+            break;
+        }
+        room            = run->Depth - run->In_Flight;
+        run->In_Flight += room;
+        pthread_mutex_unlock(&run->Lock);
+
+        for (len = 0; room != 0 && id < run->Request_Count && len < WRITE_LEN; room--, id++) {
+            const char            *path = run->Paths[id % run->Path_Count];
+            struct Request_Header hdr   = {.Length = strlen(path), .Id = id};
+
+            memcpy(buf + len, &hdr, sizeof(struct Request_Header));
+            memcpy(buf + len + sizeof(struct Request_Header), path, hdr.Length);
+            len += sizeof(struct Request_Header) + hdr.Length;
+            clock_gettime(CLOCK_MONOTONIC, &run->Sent[id]);
+        }
+
+        /* Give back the room not used */
+        pthread_mutex_lock(&run->Lock);
+        run->In_Flight -= room;
+        pthread_mutex_unlock(&run->Lock);
+
+        if (!write_full(run->Socket, buf, len)) {
+            break;
+        }
+    }
+
+    free(buf);
+
+    return NULL;
+}
+
+/**
+ * @brief Print the metadata of a response.
+ */
+static void print_response(const char *path, uint8_t *body, const struct Response_Header *resp) {
+    uint8_t                 *app1    = NULL;
+    size_t                  app1_len = 0;
+    const struct JPEG_Info  *info    = NULL;
+    const struct JPEG_GPS   *gps     = NULL;
+    struct JPEG             jpeg     = {0};
+    size_t                  ofst     = 0;
+
+    printf("%s\n", path);
+
+    if (resp->Status != JPEG_OK) {
+        printf("  %s\n", (resp->Status == JPEG_NEED_MORE_DATA) ? "Truncated before the end of the metadata" : "Not a JPEG file");
+    }
+
+    for (uint32_t i = 0; i < resp->Section_Count && ofst + sizeof(struct Section_Header) <= resp->Length; i++) {
+        struct Section_Header hdr  = {0};
+        uint8_t               *ptr = body + ofst + sizeof(struct Section_Header);
+
+        memcpy(&hdr, body + ofst, sizeof(struct Section_Header));
+        ofst += sizeof(struct Section_Header) + ((hdr.Length + 7) & ~7);
+
+        switch (hdr.Kind) {
+            case SECTION_INFO: {
+                info = (const struct JPEG_Info *)ptr;
+                printf("  Frame: %"PRIu16"x%"PRIu16", %s, quality %"PRIu8"\n", info->Width, info->Height,
+                       info->Subsampling, info->Quality);
+                break;
+            }
+
+            case SECTION_GPS: {
+                gps = (const struct JPEG_GPS *)ptr;
+                if (gps->Fields & JPEG_GPS_POSITION) {
+                    printf("  GPS: %.7f, %.7f\n", gps->Latitude, gps->Longitude);
+                }
+                break;
+            }
+
+            case SECTION_ICC: {
+                printf("  ICC: %s\n", ((const struct ICC_Profile_Info *)ptr)->Description);
+                break;
+            }
+
+            case SECTION_IPTC: {
+                for (uint32_t j = 0; j + 4 <= hdr.Length;) {
+                    uint16_t key = 0;
+                    uint16_t len = 0;
+
+                    memcpy(&key, ptr + j, 2);
+                    memcpy(&len, ptr + j + 2, 2);
+                    if (j + 4 + len > hdr.Length) {
+                        break;
+                    }
+                    printf("  IPTC %d:%d: %.*s\n", key >> 8, key & 0xFF, (int)len, (const char *)(ptr + j + 4));
+                    j += 4 + len;
+                }
+                break;
+            }
+
+            case SECTION_APP1: app1 = ptr; app1_len = hdr.Length; break;
+
+            /* The EXIF Directory is used as is, without walking the IFDs again */
+            case SECTION_EXIF: {
+                if (app1 != NULL && jpeg_exif_attach(&jpeg, app1, app1_len, ptr, hdr.Length) == JPEG_OK) {
+                    printf("  EXIF: %"PRIu32"-byte directory attached to a %zu-byte APP1\n", hdr.Length, app1_len);
+                    jpeg_free(&jpeg);
+                }
+                break;
+            }
+
+            default: break;
+        }
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/**
+ * @brief Read paths, one per line, from the given stream.
+ */
+static size_t read_paths(char ***paths, FILE *fd) {
+    char    *line = NULL;
+    size_t  cap   = 0;
+    size_t  cnt   = 0;
+    size_t  max   = 0;
+    ssize_t len   = 0;
+
+    while ((len = getline(&line, &cap, fd)) > 0) {
+        if (line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+
+        if (len == 0 || len > DAEMON_MAX_PATH) {
+            continue;
+        }
+
+        if (cnt == max) {
+            max    = (max == 0) ? 1024 : max * 2;
+            *paths = realloc(*paths, max * sizeof(char *));
+        }
+
+        (*paths)[cnt++] = strdup(line);
+    }
+
+    free(line);
+
+    return cnt;
+}
+
+int main(int argc, char *argv[]) {
+    struct Run             run      = {.Depth = DEPTH};
+    struct sockaddr_un     addr     = {.sun_family = AF_UNIX};
+    struct Response_Header resp     = {0};
+    struct timespec        t0       = {0};
+    struct timespec        t1       = {0};
+    pthread_t              writer;
+    uint8_t                *body    = NULL;
+    size_t                 body_cap = 0;
+    double                 *lat     = NULL;
+    size_t                 received = 0;
+    size_t                 failed   = 0;
+    size_t                 repeat   = 1;
+    bool                   print    = false;
+    int                    arg      = 1;
+
+    /* Parse options */
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "--depth") == 0 && arg + 1 < argc) {
+            run.Depth = strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--repeat") == 0 && arg + 1 < argc) {
+            repeat = strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--print") == 0) {
+            print = true;
+        } else {
+            break;
+        }
+    }
+
+    if (arg >= argc || strlen(argv[arg]) >= sizeof(addr.sun_path) || run.Depth == 0 || repeat == 0) {
+        printf("Usage: client [--depth <REQUESTS>] [--repeat <TIMES>] [--print] <SOCKET_PATH> [<FILE_NAME>...]\n");
+        printf("       Paths are read from stdin, one per line, if none is given.\n");
+        return 1;
+    }
+
+    strcpy(addr.sun_path, argv[arg++]);
+
+    /* Collect paths */
+    if (arg < argc) {
+        run.Paths      = argv + arg;
+        run.Path_Count = argc - arg;
+    } else {
+        run.Path_Count = read_paths(&run.Paths, stdin);
+    }
+
+    if (run.Path_Count == 0 || (uint64_t)run.Path_Count * repeat > UINT32_MAX) {
+        return 1;
+    }
+
+    run.Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (run.Socket < 0 || connect(run.Socket, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror(addr.sun_path);
+        return 1;
+    }
+
+    run.Request_Count = run.Path_Count * repeat;
+    run.Sent          = calloc(run.Request_Count, sizeof(struct timespec));
+    lat               = calloc(run.Request_Count, sizeof(double));
+    pthread_mutex_init(&run.Lock, NULL);
+    pthread_cond_init(&run.Room, NULL);
+
+    /* Pipeline the requests while reading the responses in completion order */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&writer, NULL, writer_main, &run);
+
+    while (received < run.Request_Count && read_full(run.Socket, &resp, sizeof(struct Response_Header))) {
+        if (resp.Length > body_cap) {
+            body_cap = resp.Length;
+            body     = realloc(body, body_cap);
+        }
+
+        if (!read_full(run.Socket, body, resp.Length) || resp.Id >= run.Request_Count) {
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        lat[received++]  = elapsed(&run.Sent[resp.Id], &t1);
+        failed          += (resp.Status != JPEG_OK);
+
+        pthread_mutex_lock(&run.Lock);
+        run.In_Flight--;
+        pthread_cond_signal(&run.Room);
+        pthread_mutex_unlock(&run.Lock);
+
+        if (print && resp.Id < run.Path_Count) {
+            print_response(run.Paths[resp.Id], body, &resp);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    pthread_mutex_lock(&run.Lock);
+    run.Stopped = true;
+    pthread_cond_signal(&run.Room);
+    pthread_mutex_unlock(&run.Lock);
+    shutdown(run.Socket, SHUT_RDWR);
+    pthread_join(writer, NULL);
+
+    /* Report the latency percentiles */
+    if (received != 0) {
+        qsort(lat, received, sizeof(double), compare_double);
+
+        fprintf(stderr, "┌────────────┬────────────┬────────────┬────────────┬────────────┬────────────┐\n");
+        fprintf(stderr, "│ Responses  │   Failed   │ Requests/s │  p50 (us)  │  p99 (us)  │  max (us)  │\n");
+        fprintf(stderr, "├────────────┼────────────┼────────────┼────────────┼────────────┼────────────┤\n");
+        fprintf(stderr, "│ %-10zu │ %-10zu │ %-10.0f │ %-10.1f │ %-10.1f │ %-10.1f │\n", received, failed,
+                received / elapsed(&t0, &t1), lat[received / 2] * 1e6, lat[received * 99 / 100] * 1e6,
+                lat[received - 1] * 1e6);
+        fprintf(stderr, "└────────────┴────────────┴────────────┴────────────┴────────────┴────────────┘\n");
+    }
+
+    /* Free the dynamically allocated memory */
+    if (run.Paths != argv + arg) {
+        for (size_t i = 0; i < run.Path_Count; i++) {
+            free(run.Paths[i]);
+        }
+        free(run.Paths);
+    }
+    free(run.Sent);
+    free(lat);
+    free(body);
+    close(run.Socket);
+
+    return (received == run.Request_Count) ? 0 : 1;
+}
@@ -0,0 +1,587 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+#include "daemon.h"
+
+#define MAX_THREADS     64
+#define MAX_CONNECTIONS 256             // The number of open connections before new ones wait in the backlog
+#define MAX_QUEUED      1024            // The number of requests queued before connections stop being read
+#define MAX_PENDING     128             // The number of unanswered requests of a connection before it stops being read
+#define MAX_BACKOFF     1000            // The number of milliseconds waited at most after a failed accept
+#define MAX_HEADER      (16 << 20)      // The number of bytes read at most to reach SOFn
+#define READ_LEN        (64 << 10)      // The number of bytes read at once, enough for the header of most files
+#define PADDING         16              // The number of zeroed bytes past the header, as the constructors read ahead
+
+/**
+ * @brief Response waiting for the writer thread of its connection
+ */
+struct Outbound {
+    struct Outbound *Next;      // The next response of the connection
+    size_t          Length;     // The length of the response
+    uint8_t         Data[];     // The response
+};
+
+/**
+ * @brief Client connection shared by its reader and writer threads and the workers answering its requests
+ * 
+ * Workers only queue their responses, so a client that stops reading stalls its own writer thread (and, once
+ * `MAX_PENDING` requests are unanswered, its reader thread), but neither the workers nor the other connections.
+ */
+struct Connection {
+    int             Socket;     // The connected socket
+    struct Queue    *Queue;     // The queue shared by every connection
+    struct Listener *Listener;  // The listener counting the open connections
+    pthread_t       Writer;     // The thread writing the responses
+    pthread_mutex_t Lock;       // Guards the fields below
+    pthread_cond_t  Queued;     // Signaled when a response is queued or the connection is closing
+    pthread_cond_t  Answered;   // Signaled when a response is written (or dropped)
+    struct Outbound *Head;      // The oldest response to be written
+    struct Outbound *Tail;      // The newest response to be written
+    size_t          Pending;    // The number of requests read but not answered
+    bool            Closing;    // Whether no more request will be read
+};
+
+/**
+ * @brief Request waiting for a worker
+ */
+struct Job {
+    struct Job        *Next;                        // The next job in the queue
+    struct Connection *Conn;                        // The connection to answer
+    uint32_t          Id;                           // The id of the request
+    char              Path[DAEMON_MAX_PATH + 1];    // The null-terminated path
+};
+
+/**
+ * @brief Queue of requests shared by every connection
+ */
+struct Queue {
+    pthread_mutex_t Lock;       // Guards the queue
+    pthread_cond_t  Not_Empty;  // Signaled when a job is pushed
+    pthread_cond_t  Not_Full;   // Signaled when a job is popped
+    struct Job      *Head;      // The oldest job
+    struct Job      *Tail;      // The newest job
+    size_t          Count;      // The number of jobs
+};
+
+/**
+ * @brief Worker thread state, kept warm across requests
+ */
+struct Worker {
+    pthread_t    Thread;                // The thread
+    struct Queue *Queue;                // The queue to pop jobs from
+    uint8_t      *File;                 // The header of the file being described
+    size_t       File_Capacity;         // The capacity of `File`
+    uint8_t      *Response;             // The response being built
+    size_t       Response_Length;       // The length of the response
+    size_t       Response_Capacity;     // The capacity of `Response`
+    size_t       Section;               // The offset of the header of the section being built
+};
+
+/**
+ * @brief Listening socket and the queue its connections feed
+ */
+struct Listener {
+    int             Socket;     // The listening socket
+    struct Queue    *Queue;     // The queue shared by every connection
+    pthread_mutex_t Lock;       // Guards the count of open connections
+    pthread_cond_t  Closed;     // Signaled when a connection is closed
+    size_t          Open;       // The number of open connections, each with a reader and a writer thread
+};
+
+/**
+ * @brief Write the whole byte array to the socket.
+ */
+static bool write_full(int fd, const void *buf, size_t len) {
+    const uint8_t *ptr = buf;
+    ssize_t       n    = 0;
+
+    while (len != 0) {
+        n = send(fd, ptr, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Append bytes to the response, growing it if needed.
+ * 
+ * @return The pointer to the appended bytes, valid until the next append
+ */
+static uint8_t *response_reserve(struct Worker *worker, size_t len) {
+    uint8_t *ptr = NULL;
+
+    if (worker->Response_Length + len > worker->Response_Capacity) {
+        while (worker->Response_Length + len > worker->Response_Capacity) {
+            worker->Response_Capacity *= 2;
+        }
+        worker->Response = realloc(worker->Response, worker->Response_Capacity);
+    }
+
+    ptr                      = worker->Response + worker->Response_Length;
+    worker->Response_Length += len;
+
+    return ptr;
+}
+
+static void section_begin(struct Worker *worker, uint16_t kind) {
+    struct Section_Header *hdr = NULL;
+
+    worker->Section = worker->Response_Length;
+    hdr             = (struct Section_Header *)response_reserve(worker, sizeof(struct Section_Header));
+    hdr->Kind       = kind;
+    hdr->Reserved   = 0;
+    hdr->Length     = 0;
+}
+
+static void section_end(struct Worker *worker) {
+    struct Section_Header  *hdr  = (struct Section_Header *)(worker->Response + worker->Section);
+    struct Response_Header *resp = (struct Response_Header *)worker->Response;
+    size_t                 pad   = -worker->Response_Length & 7;
+
+    hdr->Length = worker->Response_Length - worker->Section - sizeof(struct Section_Header);
+    memset(response_reserve(worker, pad), 0, pad);
+    resp->Section_Count++;
+}
+
+static void section_add(struct Worker *worker, uint16_t kind, const void *data, size_t len) {
+    section_begin(worker, kind);
+    memcpy(response_reserve(worker, len), data, len);
+    section_end(worker);
+}
+
+static void iptc_visitor(uint16_t key, const struct JPEG_View *val, void *arg) {
+    struct Worker *worker = arg;
+    uint16_t      len     = (val->Length > UINT16_MAX) ? UINT16_MAX : val->Length;
+    uint8_t       *ptr    = response_reserve(worker, 4 + len);
+
+    memcpy(ptr, &key, 2);
+    memcpy(ptr + 2, &len, 2);
+    memcpy(ptr + 4, val->Base, len);
+}
+
+/**
+ * @brief Read the header of the file up to SOFn into the buffer of the worker.
+ * 
+ * @return The number of bytes read
+ */
+static size_t header_read(struct Worker *worker, int fd, struct JPEG_Info *info, int *status) {
+    size_t  len = 0;
+    ssize_t n   = 0;
+
+    *status = JPEG_NEED_MORE_DATA;
+
+    while (*status == JPEG_NEED_MORE_DATA && len < MAX_HEADER) {
+        if (len + READ_LEN + PADDING > worker->File_Capacity) {
+            worker->File_Capacity = (len + READ_LEN + PADDING) * 2;
+            worker->File          = realloc(worker->File, worker->File_Capacity);
+        }
+
+        n = read(fd, worker->File + len, READ_LEN);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        len     += n;
+        *status  = jpeg_probe(worker->File, len, info);
+    }
+
+    memset(worker->File + len, 0, PADDING);
+
+    return len;
+}
+
+/**
+ * @brief Build the response describing the given file.
+ */
+static void describe(struct Worker *worker, const struct Job *job) {
+    struct Response_Header  *resp    = NULL;
+    struct JPEG             jpeg     = {0};
+    struct JPEG_Info        info     = {0};
+    struct JPEG_GPS         gps      = {0};
+    struct ICC_Profile_Info icc      = {0};
+    struct JPEG_View        dir      = {0};
+    struct JPEG_View        views[3] = {0};
+    size_t                  len      = 0;
+    int                     probe    = JPEG_ERROR;
+    int                     fd       = open(job->Path, O_RDONLY);
+
+    worker->Response_Length = 0;
+    resp                    = (struct Response_Header *)response_reserve(worker, sizeof(struct Response_Header));
+    resp->Id                = job->Id;
+    resp->Status            = JPEG_ERROR;
+    resp->Section_Count     = 0;
+
+    if (fd < 0) {
+        goto out;
+    }
+
+    len = header_read(worker, fd, &info, &probe);
+    close(fd);
+
+    if (probe == JPEG_OK) {
+        section_add(worker, SECTION_INFO, &info, sizeof(struct JPEG_Info));
+    }
+
+    if (!jpeg_header_complete(worker->File, len)) {
+        resp         = (struct Response_Header *)worker->Response;
+        resp->Status = (probe == JPEG_NEED_MORE_DATA) ? JPEG_NEED_MORE_DATA : JPEG_ERROR;
+        goto out;
+    }
+
+    jpeg_construct(&jpeg, worker->File);
+
+    if (jpeg_gps(&jpeg, &gps) == JPEG_OK) {
+        section_add(worker, SECTION_GPS, &gps, sizeof(struct JPEG_GPS));
+    }
+
+    if (jpeg_icc_info(&jpeg, &icc) == JPEG_OK) {
+        section_add(worker, SECTION_ICC, &icc, sizeof(struct ICC_Profile_Info));
+    }
+
+    if (jpeg.IPTC_Seg != NULL) {
+        section_begin(worker, SECTION_IPTC);
+        jpeg_iptc_visit(&jpeg, iptc_visitor, worker);
+        section_end(worker);
+    }
+
+    /* The EXIF Directory is sent as is, with the APP1 Marker Segment it refers to */
+    if (jpeg_exif_export(&jpeg, &dir) == JPEG_OK && jpeg_exif_views(&jpeg, worker->File, len, views) == 3) {
+        section_add(worker, SECTION_APP1, views[1].Base, views[1].Length);
+        section_add(worker, SECTION_EXIF, dir.Base, dir.Length);
+    }
+
+    jpeg_free(&jpeg);
+
+    resp         = (struct Response_Header *)worker->Response;
+    resp->Status = JPEG_OK;
+
+out:
+    resp         = (struct Response_Header *)worker->Response;
+    resp->Length = worker->Response_Length - sizeof(struct Response_Header);
+}
+
+static void *worker_main(void *arg) {
+    struct Worker     *worker = arg;
+    struct Queue      *queue  = worker->Queue;
+    struct Job        *job    = NULL;
+    struct Connection *conn   = NULL;
+    struct Outbound   *out    = NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->Lock);
+        while (queue->Head == NULL) {
+            pthread_cond_wait(&queue->Not_Empty, &queue->Lock);
+        }
+        job         = queue->Head;
+        queue->Head = job->Next;
+        queue->Tail = (queue->Head == NULL) ? NULL : queue->Tail;
+        queue->Count--;
+        pthread_cond_signal(&queue->Not_Full);
+        pthread_mutex_unlock(&queue->Lock);
+
+        describe(worker, job);
+
+        /* Hand the response over to the writer thread, as the client may not be reading */
+        out         = malloc(sizeof(struct Outbound) + worker->Response_Length);
+        out->Next   = NULL;
+        out->Length = worker->Response_Length;
+        memcpy(out->Data, worker->Response, worker->Response_Length);
+
+        conn = job->Conn;
+        pthread_mutex_lock(&conn->Lock);
+        if (conn->Tail != NULL) {
+            conn->Tail->Next = out;
+        } else {
+            conn->Head = out;
+        }
+        conn->Tail = out;
+        pthread_cond_signal(&conn->Queued);
+        pthread_mutex_unlock(&conn->Lock);
+
+        free(job);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Queue the request of the given connection, waiting while the queue is full.
+ */
+static void queue_push(struct Queue *queue, struct Connection *conn, uint32_t id, const char *path, uint32_t len) {
+    struct Job *job = malloc(sizeof(struct Job));
+
+    job->Next = NULL;
+    job->Conn = conn;
+    job->Id   = id;
+    memcpy(job->Path, path, len);
+    job->Path[len] = '\0';
+
+    /* Stop reading a client that does not read its responses */
+    pthread_mutex_lock(&conn->Lock);
+    while (conn->Pending >= MAX_PENDING) {
+        pthread_cond_wait(&conn->Answered, &conn->Lock);
+    }
+    conn->Pending++;
+    pthread_mutex_unlock(&conn->Lock);
+
+    pthread_mutex_lock(&queue->Lock);
+    while (queue->Count >= MAX_QUEUED) {
+        pthread_cond_wait(&queue->Not_Full, &queue->Lock);
+    }
+    if (queue->Tail != NULL) {
+        queue->Tail->Next = job;
+    } else {
+        queue->Head = job;
+    }
+    queue->Tail = job;
+    queue->Count++;
+    pthread_cond_signal(&queue->Not_Empty);
+    pthread_mutex_unlock(&queue->Lock);
+}
+
+/**
+ * @brief Write the responses of a connection in completion order, until it is closing and every one is written.
+ */
+static void *writer_main(void *arg) {
+    struct Connection *conn  = arg;
+    struct Outbound   *out   = NULL;
+    bool              broken = false;
+
+    pthread_mutex_lock(&conn->Lock);
+
+    for (;;) {
+        while (conn->Head == NULL && !conn->Closing) {
+            pthread_cond_wait(&conn->Queued, &conn->Lock);
+        }
+        if (conn->Head == NULL) {
+            break;
+        }
+
+        out        = conn->Head;
+        conn->Head = out->Next;
+        conn->Tail = (conn->Head == NULL) ? NULL : conn->Tail;
+        pthread_mutex_unlock(&conn->Lock);
+
+        /* Once a write fails, the client is gone: its reader thread is woken up and the responses are dropped */
+        if (!broken && !write_full(conn->Socket, out->Data, out->Length)) {
+            broken = true;
+            shutdown(conn->Socket, SHUT_RD);
+        }
+        free(out);
+
+        pthread_mutex_lock(&conn->Lock);
+        conn->Pending--;
+        pthread_cond_broadcast(&conn->Answered);
+    }
+
+    pthread_mutex_unlock(&conn->Lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Read the requests of a connection, as many at once as the client has written, until it hangs up.
+ */
+static void *connection_main(void *arg) {
+    struct Connection *conn     = arg;
+    struct Listener   *listener = conn->Listener;
+    size_t            cap       = 2 * (sizeof(struct Request_Header) + DAEMON_MAX_PATH);
+    uint8_t           *buf      = malloc(cap);
+    size_t            have      = 0;
+    size_t            ofst      = 0;
+    ssize_t           n         = 0;
+
+    pthread_mutex_init(&conn->Lock, NULL);
+    pthread_cond_init(&conn->Queued, NULL);
+    pthread_cond_init(&conn->Answered, NULL);
+    pthread_create(&conn->Writer, NULL, writer_main, conn);
+
+    while ((n = read(conn->Socket, buf + have, cap - have)) > 0 || (n < 0 && errno == EINTR)) {
+        struct Request_Header hdr = {0};
+
+        have += (n > 0) ? n : 0;
+
+        /* Queue every complete request */
+        for (ofst = 0; have - ofst >= sizeof(struct Request_Header); ofst += sizeof(struct Request_Header) + hdr.Length) {
+            memcpy(&hdr, buf + ofst, sizeof(struct Request_Header));
+            if (hdr.Length > DAEMON_MAX_PATH) {
+                goto out;
+            }
+            if (have - ofst < sizeof(struct Request_Header) + hdr.Length) {
+                break;
+            }
+            queue_push(conn->Queue, conn, hdr.Id, (char *)buf + ofst + sizeof(struct Request_Header), hdr.Length);
+        }
+
+        memmove(buf, buf + ofst, have - ofst);
+        have -= ofst;
+    }
+
+out:
+    /* The connection is freed once every queued request is answered */
+    shutdown(conn->Socket, SHUT_RD);
+    pthread_mutex_lock(&conn->Lock);
+    while (conn->Pending != 0) {
+        pthread_cond_wait(&conn->Answered, &conn->Lock);
+    }
+    conn->Closing = true;
+    pthread_cond_signal(&conn->Queued);
+    pthread_mutex_unlock(&conn->Lock);
+    pthread_join(conn->Writer, NULL);
+
+    close(conn->Socket);
+    pthread_cond_destroy(&conn->Answered);
+    pthread_cond_destroy(&conn->Queued);
+    pthread_mutex_destroy(&conn->Lock);
+    free(conn);
+    free(buf);
+
+    pthread_mutex_lock(&listener->Lock);
+    listener->Open--;
+    pthread_cond_signal(&listener->Closed);
+    pthread_mutex_unlock(&listener->Lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Serve each connection from its own reader thread, up to `MAX_CONNECTIONS` at once.
+ * 
+ * Further clients wait in the backlog of the socket. When accept keeps failing (e.g. out of file descriptors), the
+ * listener backs off instead of retrying at once, as the pending connection stays readable.
+ */
+static void *listener_main(void *arg) {
+    struct Listener *listener = arg;
+    int             backoff   = 0;
+
+    for (;;) {
+        struct Connection *conn   = NULL;
+        pthread_t         thread;
+        int               sock    = -1;
+
+        pthread_mutex_lock(&listener->Lock);
+        while (listener->Open >= MAX_CONNECTIONS) {
+            pthread_cond_wait(&listener->Closed, &listener->Lock);
+        }
+        pthread_mutex_unlock(&listener->Lock);
+
+        sock = accept(listener->Socket, NULL, NULL);
+        if (sock < 0) {
+            /* Retry at once only when the client went away or a signal interrupted the call */
+            if (errno != EINTR && errno != ECONNABORTED) {
+                backoff = (backoff == 0) ? 10 : (2 * backoff > MAX_BACKOFF) ? MAX_BACKOFF : 2 * backoff;
+                poll(NULL, 0, backoff);
+            }
+            continue;
+        }
+        backoff = 0;
+
+        pthread_mutex_lock(&listener->Lock);
+        listener->Open++;
+        pthread_mutex_unlock(&listener->Lock);
+
+        conn           = calloc(1, sizeof(struct Connection));
+        conn->Socket   = sock;
+        conn->Queue    = listener->Queue;
+        conn->Listener = listener;
+        pthread_create(&thread, NULL, connection_main, conn);
+        pthread_detach(thread);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    struct Queue       queue                = {0};
+    struct Worker      workers[MAX_THREADS] = {0};
+    struct Listener    listener             = {.Socket = -1, .Queue = &queue};
+    struct sockaddr_un addr                 = {.sun_family = AF_UNIX};
+    pthread_t          thread;
+    sigset_t           signals;
+    long               thread_cnt           = sysconf(_SC_NPROCESSORS_ONLN);
+    const char         *path                = NULL;
+    int                sig                  = 0;
+    int                arg                  = 1;
+
+    /* Parse options */
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            thread_cnt = atol(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+
+    if (arg + 1 != argc || strlen(argv[arg]) >= sizeof(addr.sun_path)) {
+        printf("Usage: daemon [-j <THREADS>] <SOCKET_PATH>\n");
+        return 1;
+    }
+
+    path       = argv[arg];
+    thread_cnt = (thread_cnt < 1) ? 1 : (thread_cnt > MAX_THREADS) ? MAX_THREADS : thread_cnt;
+    strcpy(addr.sun_path, path);
+
+    /* Listen on the socket, replacing a stale one */
+    listener.Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listener.Socket < 0 || bind(listener.Socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener.Socket, 64) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    /* SIGINT and SIGTERM are left to the main thread, which removes the socket */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Start the workers with their buffers allocated up front */
+    pthread_mutex_init(&queue.Lock, NULL);
+    pthread_cond_init(&queue.Not_Empty, NULL);
+    pthread_cond_init(&queue.Not_Full, NULL);
+    pthread_mutex_init(&listener.Lock, NULL);
+    pthread_cond_init(&listener.Closed, NULL);
+
+    for (long i = 0; i < thread_cnt; i++) {
+        workers[i].Queue             = &queue;
+        workers[i].File_Capacity     = 2 * (READ_LEN + PADDING);
+        workers[i].File              = malloc(workers[i].File_Capacity);
+        workers[i].Response_Capacity = READ_LEN;
+        workers[i].Response          = malloc(workers[i].Response_Capacity);
+        pthread_create(&workers[i].Thread, NULL, worker_main, &workers[i]);
+    }
+
+    pthread_create(&thread, NULL, listener_main, &listener);
+
+    sigwait(&signals, &sig);
+
+    close(listener.Socket);
+    unlink(path);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file   daemon.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Framing of the messages exchanged with the metadata daemon over a Unix domain socket.
+ * 
+ * A client writes any number of requests without waiting for the responses, which come back in completion order
+ * and are matched by their ids. All integers and structs are in host layout, as both ends run on the same machine.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdint.h>
+
+/**
+ * @brief Maximum length of a requested path in bytes
+ */
+#define DAEMON_MAX_PATH     4096
+
+/**
+ * @brief Kinds of response sections, each present only if the corresponding metadata is
+ */
+#define SECTION_INFO        1   // struct JPEG_Info from the SOFn and DQT Marker Segments
+#define SECTION_GPS         2   // struct JPEG_GPS from the GPS IFD
+#define SECTION_ICC         3   // struct ICC_Profile_Info from the ICC Segment
+#define SECTION_IPTC        4   // IPTC datasets in file order, each as a 2-byte key, a 2-byte length and the value
+#define SECTION_APP1        5   // The APP1 Marker Segment of the EXIF Segment, from MARKER
+#define SECTION_EXIF        6   // The EXIF Directory of SECTION_APP1, to be attached with `jpeg_exif_attach`
+
+/**
+ * @brief Request header, followed by the path without a null byte
+ */
+struct Request_Header {
+    uint32_t Length;    // The length of the path
+    uint32_t Id;        // The id echoed by the response
+};
+
+/**
+ * @brief Response header, followed by the sections
+ */
+struct Response_Header {
+    uint32_t Length;            // The length of the sections
+    uint32_t Id;                // The id of the request
+    int32_t  Status;            // JPEG_OK, JPEG_NEED_MORE_DATA if the file ends within its header, JPEG_ERROR otherwise
+    uint32_t Section_Count;     // The number of sections
+};
+
+/**
+ * @brief Section header, followed by the section padded to 8 bytes
+ */
+struct Section_Header {
+    uint16_t Kind;      // One of SECTION_*
+    uint16_t Reserved;  // 0
+    uint32_t Length;    // The length of the section without padding
+};
+
+#endif /* DAEMON_H */
@@ -5,9 +5,10 @@
 #include "jpeg.h"
 
 int main(int argc, char *argv[]) {
-    FILE        *fd   = NULL;
-    uint8_t     *buf  = NULL;
-    struct JPEG *jpeg = NULL;
+    FILE            *fd   = NULL;
+    uint8_t         *buf  = NULL;
+    struct JPEG     *jpeg = NULL;
+    struct JPEG_GPS gps   = {0};
 
     /* Allocate dynamic memory */
     buf  = calloc(1024000, 1);
@@ -30,6 +31,22 @@ int main(int argc, char *argv[]) {
     /* Parse JPEG struct */
     jpeg_parse(jpeg);
 
+    /* Print the position and time decoded from the GPS IFD */
+    if (jpeg_gps(jpeg, &gps) == JPEG_OK) {
+        if (gps.Fields & JPEG_GPS_POSITION) {
+            printf("GPS Position: %.7f, %.7f\n", gps.Latitude, gps.Longitude);
+        }
+        if (gps.Fields & JPEG_GPS_ALTITUDE) {
+            printf("GPS Altitude: %.2f m\n", gps.Altitude);
+        }
+        if (gps.Fields & JPEG_GPS_TIME) {
+            printf("GPS Time: %s%s%02d:%02d:%06.3f UTC\n", gps.Date, (gps.Fields & JPEG_GPS_DATE) ? " " : "",
+                   (int)(gps.Time / 3600), (int)(gps.Time / 60) % 60, gps.Time - 60 * (int)(gps.Time / 60));
+        } else if (gps.Fields & JPEG_GPS_DATE) {
+            printf("GPS Date: %s\n", gps.Date);
+        }
+    }
+
     /* Free the dynamically allocated memory */
     jpeg_free(jpeg);
     free(jpeg);
@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+
+#define HEAD_LEN    1024000
+
+/**
+ * @brief Copy a byte range between files in the kernel, falling back to a user-space copy.
+ */
+static int copy_range(int in_fd, off_t in_ofst, int out_fd, size_t len) {
+    uint8_t buf[65536];
+    ssize_t n = 0;
+
+    while (len > 0) {
+        n = copy_file_range(in_fd, &in_ofst, out_fd, NULL, len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len -= n;
+    }
+
+    /* Fall back for file systems or kernels without copy_file_range */
+    while (len > 0) {
+        n = pread(in_fd, buf, (len < sizeof(buf)) ? len : sizeof(buf), in_ofst);
+        if (n <= 0 || write(out_fd, buf, n) != n) {
+            return -1;
+        }
+        in_ofst += n;
+        len     -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Write the whole of the buffers, resuming after short writes.
+ */
+static int writev_all(int fd, struct iovec *iov, int cnt) {
+    ssize_t n = 0;
+
+    while (cnt > 0) {
+        n = writev(fd, iov, cnt);
+        if (n < 0) {
+            return -1;
+        }
+
+        /* Skip the buffers written in full, then the written part of the next one */
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base  = (uint8_t *)iov->iov_base + n;
+            iov->iov_len  -= n;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int              in_fd       = -1;
+    int              out_fd      = -1;
+    struct stat      st          = {0};
+    uint8_t          *buf        = NULL;
+    ssize_t          head_len    = 0;
+    struct JPEG      *jpeg       = NULL;
+    struct JPEG_View views[3]    = {0};
+    uint8_t          *app1       = NULL;
+    size_t           app1_len    = 0;
+    struct iovec     iov[2]      = {0};
+    const char       *in_path    = NULL;
+    const char       *out_path   = NULL;
+    long             orientation = 0;
+    char             *end        = NULL;
+    const char       *date_time  = NULL;
+    int              strip_gps   = 0;
+    int              rebuild     = 0;
+    int              status      = JPEG_OK;
+    int              ret         = 0;
+
+    /* Parse arguments */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--orientation") == 0 && i + 1 < argc) {
+            orientation = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || orientation < 1 || orientation > 8) {
+                printf("Invalid orientation \"%s\", expected 1 to 8\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--datetime") == 0 && i + 1 < argc) {
+            date_time = argv[++i];
+        } else if (strcmp(argv[i], "--strip-gps") == 0) {
+            strip_gps = 1;
+        } else if (in_path == NULL) {
+            in_path = argv[i];
+        } else {
+            out_path = argv[i];
+        }
+    }
+
+    if (in_path == NULL) {
+        printf("Usage: patch [--orientation <1-8>] [--datetime <YYYY:MM:DD HH:MM:SS>] [--strip-gps] <IN_FILE> [<OUT_FILE>]\n");
+        return 1;
+    }
+
+    /* Read the head of the image, which holds the APP Marker Segments */
+    in_fd = open(in_path, (out_path == NULL) ? O_RDWR : O_RDONLY);
+    if (in_fd < 0 || fstat(in_fd, &st) != 0) {
+        perror(in_path);
+        return 1;
+    }
+
+    buf      = calloc(HEAD_LEN, 1);
+    jpeg     = calloc(1, sizeof(struct JPEG));
+    head_len = pread(in_fd, buf, HEAD_LEN, 0);
+
+    /* The APP Marker Segments must end within the head, as jpeg_construct trusts LENGTH */
+    if (head_len < 0 || !jpeg_header_complete(buf, head_len)) {
+        printf("Cannot read the header of %s\n", in_path);
+        ret = 1;
+        goto out;
+    }
+
+    /* Construct JPEG struct */
+    jpeg_construct(jpeg, buf);
+
+    /* Keep the original APP1, to tell whether patches in place changed it */
+    if (jpeg_exif_views(jpeg, buf, head_len, views) != 3) {
+        printf("No EXIF Segment to patch\n");
+        ret = 1;
+        goto out;
+    }
+
+    app1_len = views[1].Length;
+    app1     = malloc(app1_len);
+    memcpy(app1, views[1].Base, app1_len);
+
+    /* Apply patches */
+    if (orientation != 0) {
+        uint16_t val = orientation;
+        status = jpeg_exif_set(jpeg, EXIF_IFD_TIFF, 0x0112, EXIF_TYPE_SHORT, 1, &val);
+        if (status == JPEG_ERROR) {
+            printf("Cannot set Orientation\n");
+            ret = 1;
+            goto out;
+        }
+        rebuild |= status == JPEG_REBUILD;
+    }
+
+    if (date_time != NULL) {
+        status = jpeg_exif_set(jpeg, EXIF_IFD_TIFF, 0x0132, EXIF_TYPE_ASCII, strlen(date_time) + 1, date_time);
+        if (status == JPEG_ERROR) {
+            printf("Cannot set DateTime\n");
+            ret = 1;
+            goto out;
+        }
+        rebuild |= status == JPEG_REBUILD;
+    }
+
+    if (strip_gps) {
+        status = jpeg_exif_remove(jpeg, EXIF_IFD_TIFF, 0x8825);
+        if (status == JPEG_ERROR) {
+            printf("No GPS IFD to strip\n");
+            ret = 1;
+            goto out;
+        }
+        rebuild |= status == JPEG_REBUILD;
+    }
+
+    if (jpeg_exif_views(jpeg, buf, head_len, views) != 3) {
+        printf("Patched EXIF Segment does not fit in APP1\n");
+        ret = 1;
+    } else if (!rebuild && memcmp(app1, views[1].Base, app1_len) == 0) {
+        /* Leave the file untouched, or copy it as is */
+        printf("Nothing to change\n");
+        if (out_path != NULL) {
+            out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out_fd < 0 || copy_range(in_fd, 0, out_fd, st.st_size) != 0) {
+                perror(out_path);
+                ret = 1;
+            }
+        }
+    } else if (out_path == NULL) {
+        /* Write the patched APP1 back over itself */
+        if (rebuild) {
+            printf("Patch changes the size of APP1, an output file is required\n");
+            ret = 1;
+        } else if (pwrite(in_fd, views[1].Base, views[1].Length, views[0].Length) != (ssize_t)views[1].Length) {
+            perror(in_path);
+            ret = 1;
+        }
+    } else {
+        /* Write the prefix and APP1 from memory, then copy the remainder from the source file */
+        out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        iov[0].iov_base = (void *)views[0].Base;
+        iov[0].iov_len  = views[0].Length;
+        iov[1].iov_base = (void *)views[1].Base;
+        iov[1].iov_len  = views[1].Length;
+
+        if (out_fd < 0 || writev_all(out_fd, iov, 2) != 0 ||
+            copy_range(in_fd, views[2].Base - buf, out_fd, st.st_size - (views[2].Base - buf)) != 0) {
+            perror(out_path);
+            ret = 1;
+        }
+    }
+
+    if (out_fd >= 0) {
+        close(out_fd);
+    }
+
+out:
+    /* Free the dynamically allocated memory */
+    jpeg_free(jpeg);
+    free(jpeg);
+    free(buf);
+    free(app1);
+    close(in_fd);
+
+    return ret;
+}
@@ -0,0 +1,428 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+
+#define MAX_VIEWS   64
+#define CHUNK_LEN   (1 << 30)
+
+/**
+ * @brief Names accepted by --keep
+ */
+static const struct {
+    const char *Name;
+    uint32_t   Flag;
+} keep_names[] = {
+    {"jfif",        JPEG_KEEP_JFIF},
+    {"exif",        JPEG_KEEP_EXIF},
+    {"orientation", JPEG_KEEP_ORIENTATION},
+    {"xmp",         JPEG_KEEP_XMP},
+    {"icc",         JPEG_KEEP_ICC},
+    {"iptc",        JPEG_KEEP_IPTC},
+    {"comment",     JPEG_KEEP_COMMENT},
+    {"other",       JPEG_KEEP_OTHER},
+    {"trailer",     JPEG_KEEP_TRAILER},
+};
+
+/**
+ * @brief Parse a comma-separated keep-list.
+ */
+static int parse_keep(char *list, uint32_t *keep) {
+    *keep = 0;
+
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        size_t i = 0;
+
+        for (i = 0; i < sizeof(keep_names) / sizeof(keep_names[0]); i++) {
+            if (strcmp(name, keep_names[i].Name) == 0) {
+                *keep |= keep_names[i].Flag;
+                break;
+            }
+        }
+
+        if (i == sizeof(keep_names) / sizeof(keep_names[0])) {
+            fprintf(stderr, "Unknown metadata \"%s\"\n", name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Write the whole byte range, retrying on partial writes.
+ */
+static int write_all(int fd, const uint8_t *ptr, size_t len) {
+    ssize_t n = 0;
+
+    while (len > 0) {
+        n = write(fd, ptr, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        ptr += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Copy a range of the input file to the output without passing it through user space when possible.
+ * 
+ * copy_file_range is used between regular files, splice to a pipe, and sendfile to anything else. Each falls back
+ * to writing from the mapping of the input if the kernel or file system refuses.
+ */
+static int transfer(int in_fd, int out_fd, const struct stat *out_st, const uint8_t *map, off_t ofst, size_t len) {
+    ssize_t n = 0;
+
+    while (len > 0) {
+        if (S_ISREG(out_st->st_mode)) {
+            n = copy_file_range(in_fd, &ofst, out_fd, NULL, (len < CHUNK_LEN) ? len : CHUNK_LEN, 0);
+        } else if (S_ISFIFO(out_st->st_mode)) {
+            n = splice(in_fd, &ofst, out_fd, NULL, (len < CHUNK_LEN) ? len : CHUNK_LEN, SPLICE_F_MOVE | SPLICE_F_MORE);
+        } else {
+            n = sendfile(out_fd, in_fd, &ofst, (len < CHUNK_LEN) ? len : CHUNK_LEN);
+        }
+
+        if (n <= 0) {
+            break;
+        }
+        len -= n;
+    }
+
+    /* Fall back to a user-space copy from where the kernel copy stopped */
+    return (len == 0) ? 0 : write_all(out_fd, map + ofst, len);
+}
+
+/**
+ * @brief Write the views with as few system calls as possible.
+ */
+static int write_views(int fd, const struct JPEG_View *views, size_t view_cnt) {
+    struct iovec iov[MAX_VIEWS] = {0};
+    ssize_t      n              = 0;
+
+    for (size_t i = 0; i < view_cnt; i++) {
+        iov[i].iov_base = (void *)views[i].Base;
+        iov[i].iov_len  = views[i].Length;
+    }
+
+    n = writev(fd, iov, view_cnt);
+    if (n < 0 && errno != EINTR) {
+        return -1;
+    }
+
+    /* Finish a partial write, e.g. to a pipe */
+    n = (n < 0) ? 0 : n;
+    for (size_t i = 0; i < view_cnt; i++) {
+        size_t done = ((size_t)n < views[i].Length) ? (size_t)n : views[i].Length;
+
+        n -= done;
+        if (write_all(fd, views[i].Base + done, views[i].Length - done) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Strip the metadata of the JPEG file read from `in_fd` into `out_fd`.
+ * 
+ * Only the header up to SOS is read into memory. The rest of a regular file is mapped to find the Marker Segments
+ * between scans and EOI, and the entropy-coded data in between is transferred by the kernel. The rest of a stream is
+ * read into memory.
+ */
+static int strip(int in_fd, int out_fd, uint32_t keep) {
+    uint8_t             *buf             = NULL;
+    uint8_t             *map             = MAP_FAILED;
+    const uint8_t       *file            = NULL;
+    size_t              cap              = 65536;
+    size_t              len              = 0;
+    size_t              file_len         = 0;
+    size_t              ofst             = 2;
+    ssize_t             n                = 0;
+    off_t               start            = lseek(in_fd, 0, SEEK_CUR);
+    struct stat         in_st            = {0};
+    struct stat         out_st           = {0};
+    struct JPEG_Segment seg              = {0};
+    struct JPEG         jpeg             = {0};
+    struct JPEG_View    views[MAX_VIEWS] = {0};
+    size_t              view_cnt         = 0;
+    bool                complete         = false;
+    int                 ret              = -1;
+
+    if (fstat(in_fd, &in_st) != 0 || fstat(out_fd, &out_st) != 0) {
+        perror("fstat");
+        return -1;
+    }
+
+    buf = malloc(cap);
+
+    /* Read until the header of SOS is complete */
+    while (1) {
+        int status = jpeg_segment(buf, len, ofst, &seg);
+
+        if (len >= 2 && (buf[0] != 0xFF || buf[1] != 0xD8)) {
+            fprintf(stderr, "Not a JPEG file\n");
+            goto out;
+        }
+
+        if (status == JPEG_OK && seg.Marker == 0xFFDA) {
+            break;
+        } else if (status == JPEG_OK) {
+            ofst = seg.Offset + seg.Length;
+            continue;
+        } else if (status == JPEG_ERROR) {
+            fprintf(stderr, "Invalid marker at offset %zu\n", ofst);
+            goto out;
+        }
+
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+
+        n = read(in_fd, buf + len, cap - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "Truncated JPEG file\n");
+            goto out;
+        }
+        len += n;
+    }
+
+    /* Construct JPEG struct and write the header without the unwanted metadata */
+    jpeg_construct(&jpeg, buf);
+    view_cnt = jpeg_strip_views(&jpeg, buf, len, keep, views, MAX_VIEWS);
+    if (view_cnt == 0) {
+        fprintf(stderr, "Too many Marker Segments\n");
+        goto out;
+    }
+
+    if (write_views(out_fd, views, view_cnt) != 0) {
+        perror("write");
+        goto out;
+    }
+
+    /* Map a regular file read from its start, or read the rest of the stream */
+    if (S_ISREG(in_st.st_mode) && start == 0 && in_st.st_size > 0) {
+        map = mmap(NULL, in_st.st_size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+    }
+
+    if (map != MAP_FAILED) {
+        madvise(map, in_st.st_size, MADV_SEQUENTIAL);
+        file     = map;
+        file_len = in_st.st_size;
+    } else {
+        /* The header may have filled the buffer, so grow it before each read */
+        while (1) {
+            if (len == cap) {
+                cap *= 2;
+                buf = realloc(buf, cap);
+            }
+
+            n = read(in_fd, buf + len, cap - len);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+        }
+        if (n < 0) {
+            perror("read");
+            goto out;
+        }
+        file     = buf;
+        file_len = len;
+    }
+
+    /* Write the scans up to EOI without the unwanted metadata in between */
+    view_cnt = jpeg_strip_tail_views(file, file_len, seg.Offset, keep, views, MAX_VIEWS, &complete);
+    if (view_cnt == 0) {
+        fprintf(stderr, "Too many Marker Segments\n");
+        goto out;
+    }
+
+    for (size_t i = 0; i < view_cnt && map != MAP_FAILED; i++) {
+        if (transfer(in_fd, out_fd, &out_st, map, views[i].Base - map, views[i].Length) != 0) {
+            perror("write");
+            goto out;
+        }
+    }
+
+    if (map == MAP_FAILED && write_views(out_fd, views, view_cnt) != 0) {
+        perror("write");
+        goto out;
+    }
+
+    /* The output of a truncated file is as complete as possible, but still reported */
+    if (!complete) {
+        fprintf(stderr, "Truncated JPEG file\n");
+        goto out;
+    }
+
+    ret = 0;
+
+out:
+    if (map != MAP_FAILED) {
+        munmap(map, in_st.st_size);
+    }
+    jpeg_free(&jpeg);
+    free(buf);
+    return ret;
+}
+
+/**
+ * @brief Write a synthetic JPEG file whose entropy-coded data has the given length.
+ */
+static int bench_file(const char *path, size_t data_len) {
+    static const uint8_t header[] = {
+        0xFF, 0xD8,
+        0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x02, 0x01, 0x00, 0x48, 0x00, 0x48, 0x00, 0x00,
+        0xFF, 0xE1, 0x00, 0x2E, 'E', 'x', 'i', 'f', 0x00, 0x00,
+        'I', 'I', 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00,
+        0x02, 0x00,
+        0x0F, 0x01, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 'A', 'B', 'C', 0x00,
+        0x12, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x01, 0xE0, 0x02, 0x80, 0x01, 0x01, 0x11, 0x00,
+        0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00,
+    };
+    uint8_t *data = malloc(1 << 20);
+    FILE    *fd   = fopen(path, "wb");
+
+    if (fd == NULL) {
+        free(data);
+        return -1;
+    }
+
+    /* Entropy-coded data never contains an unstuffed 0xFF */
+    for (size_t i = 0; i < (1 << 20); i++) {
+        data[i] = (uint8_t)(i * 2654435761u >> 24) & 0x7F;
+    }
+
+    fwrite(header, sizeof(header), 1, fd);
+    for (size_t i = 0; i < data_len; i += (1 << 20)) {
+        fwrite(data, ((data_len - i) < (1 << 20)) ? data_len - i : (1 << 20), 1, fd);
+    }
+    fwrite("\xFF\xD9", 2, 1, fd);
+    fclose(fd);
+    free(data);
+
+    return 0;
+}
+
+/**
+ * @brief Measure the stripping throughput against the file size, file to file.
+ */
+static int bench(size_t max_mb) {
+    const char      *tmp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char            in_path[256];
+    char            out_path[256];
+    struct timespec t0 = {0};
+    struct timespec t1 = {0};
+
+    snprintf(in_path,  sizeof(in_path),  "%s/strip-bench-in.jpg",  tmp_dir);
+    snprintf(out_path, sizeof(out_path), "%s/strip-bench-out.jpg", tmp_dir);
+
+    printf("┌────────────┬────────┬────────────┬────────────┐\n");
+    printf("│ Size (MiB) │  Runs  │ Time (ms)  │   MiB/s    │\n");
+    printf("├────────────┼────────┼────────────┼────────────┤\n");
+
+    for (size_t mb = 1; mb <= max_mb; mb *= 4) {
+        int    runs = (mb < 64) ? (int)(256 / mb) : 4;
+        double secs = 0;
+
+        if (bench_file(in_path, mb << 20) != 0) {
+            perror(in_path);
+            return 1;
+        }
+
+        for (int i = 0; i < runs; i++) {
+            int in_fd  = open(in_path, O_RDONLY);
+            int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            strip(in_fd, out_fd, JPEG_KEEP_JFIF | JPEG_KEEP_ORIENTATION);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+
+            secs += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            close(in_fd);
+            close(out_fd);
+        }
+
+        printf("│ %-10zu │ %-6d │ %-10.3f │ %-10.1f │\n", mb, runs, secs * 1e3 / runs, mb * runs / secs);
+    }
+
+    printf("└────────────┴────────┴────────────┴────────────┘\n");
+    unlink(in_path);
+    unlink(out_path);
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t   keep      = JPEG_KEEP_JFIF;
+    const char *in_path  = NULL;
+    const char *out_path = NULL;
+    int        in_fd     = STDIN_FILENO;
+    int        out_fd    = STDOUT_FILENO;
+    int        ret       = 0;
+
+    /* Parse arguments */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keep") == 0 && i + 1 < argc) {
+            if (parse_keep(argv[++i], &keep) != 0) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            return bench((i + 1 < argc) ? strtoul(argv[i + 1], NULL, 10) : 256);
+        } else if (in_path == NULL) {
+            in_path = argv[i];
+        } else {
+            out_path = argv[i];
+        }
+    }
+
+    if (in_path != NULL && strcmp(in_path, "-") != 0) {
+        in_fd = open(in_path, O_RDONLY);
+    }
+
+    if (out_path != NULL && strcmp(out_path, "-") != 0) {
+        out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (in_fd < 0 || out_fd < 0) {
+        perror((in_fd < 0) ? in_path : out_path);
+        printf("Usage: strip [--keep jfif,exif,orientation,xmp,icc,iptc,comment,other,trailer] [<IN_FILE> [<OUT_FILE>]]\n");
+        printf("       strip --bench [<MAX_MIB>]\n");
+        return 1;
+    }
+
+    ret = (strip(in_fd, out_fd, keep) == 0) ? 0 : 1;
+
+    close(in_fd);
+    close(out_fd);
+
+    return ret;
+}
@@ -0,0 +1,96 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jpeg.h"
+
+#define CHUNK_LEN   1460    // The payload of a TCP segment over Ethernet
+
+int main(int argc, char *argv[]) {
+    int                 fd         = -1;
+    struct stat         st         = {0};
+    uint8_t             *chunk     = NULL;
+    size_t              chunk_len  = CHUNK_LEN;
+    ssize_t             n          = 0;
+    size_t              received   = 0;
+    struct JPEG         jpeg       = {0};
+    struct JPEG_Filter  *filter    = NULL;
+    struct JPEG_Parser  *parser    = NULL;
+    const char          *path      = NULL;
+    bool                print      = false;
+    int                 ret        = JPEG_NEED_MORE_DATA;
+
+    /* Parse options */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunk_len = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+            filter = jpeg_filter_compile(argv[++i]);
+            if (filter == NULL) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--print") == 0) {
+            print = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL || chunk_len == 0) {
+        printf("Usage: upload [--chunk <BYTES>] [--where <PREDICATE>] [--print] <FILE_NAME>\n");
+        return 1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    /* Feed the file chunk by chunk as if it was received from the network, stopping once the metadata is complete */
+    chunk       = malloc(chunk_len);
+    jpeg.Filter = filter;
+    parser      = jpeg_parser_create(&jpeg);
+
+    while (ret != JPEG_DONE && ret != JPEG_ERROR && (n = read(fd, chunk, chunk_len)) > 0) {
+        received += n;
+        ret       = jpeg_parser_feed(parser, chunk, n);
+
+        if (ret == JPEG_EXIF_READY) {
+            printf("EXIF Segment ready after %zu of %lld bytes\n", received, (long long)st.st_size);
+        }
+    }
+
+    switch (ret) {
+        case JPEG_DONE: {
+            printf("Metadata complete after %zu of %lld bytes\n", received, (long long)st.st_size);
+            if (jpeg.EXIF_Seg == NULL) {
+                printf("No presence of EXIF Segment\n");
+            }
+            if (filter != NULL) {
+                printf("Predicate is %s\n", jpeg_filter_match(&jpeg) ? "true" : "false");
+            }
+            if (print) {
+                jpeg_parse(&jpeg);
+            }
+            break;
+        }
+
+        case JPEG_ERROR: printf("Not a JPEG file\n"); break;
+        default:         printf("Truncated before the end of the metadata\n"); break;
+    }
+
+    /* Free the dynamically allocated memory, the JPEG struct referring to the buffers of the parser */
+    jpeg_free(&jpeg);
+    jpeg_parser_free(parser);
+    jpeg_filter_free(filter);
+    free(chunk);
+    close(fd);
+
+    return (ret == JPEG_DONE) ? 0 : 1;
+}
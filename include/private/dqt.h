@@ -0,0 +1,52 @@
+/**
+ * @file   dqt.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Functions to parse DQT Marker Segments and estimate the encoding quality.
+ */
+
+#ifndef DQT_H
+#define DQT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Quantization tables representation
+ * 
+ * Reference: ISO/IEC 10918-1:1993, pp.39-40
+ */
+struct DQT_Tables {
+    uint8_t  Present;           // The bit mask of the destinations defined so far
+    uint8_t  Wide;              // The bit mask of the destinations defined with 16-bit precision
+    uint16_t Table[4][64];      // The quantization tables by destination, in natural (row-major) order
+};
+
+/**
+ * @brief Parse a DQT Marker Segment, which may define several tables of 8-bit or 16-bit precision.
+ * 
+ * @param tables  The pointer to the DQT Tables struct
+ * @param ptr     The pointer to the first byte after LENGTH
+ * @param len     The number of bytes after LENGTH
+ * 
+ * @return true on success, false if the Marker Segment is malformed
+ */
+bool dqt_construct(struct DQT_Tables *tables, const uint8_t *ptr, size_t len);
+
+/**
+ * @brief Estimate the IJG-equivalent quality of the given luminance and chrominance tables.
+ * 
+ * @param tables  The pointer to the DQT Tables struct
+ * @param lum     The destination of the luminance table
+ * @param chroma  The destination of the chrominance table, or -1 for grayscale images
+ * @param quality The pointer to the estimated quality (1 to 100)
+ * 
+ * @return true if the tables are exactly those libjpeg produces at the estimated quality
+ */
+bool dqt_quality(const struct DQT_Tables *tables, uint8_t lum, int chroma, uint8_t *quality);
+
+#endif /* DQT_H */
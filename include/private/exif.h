@@ -11,8 +11,13 @@
 #ifndef EXIF_H
 #define EXIF_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "jpeg.h"
+#include "filter.h"
+
 /**
  * @brief Image File Directory byte orders
  * 
@@ -39,33 +44,101 @@
 #define FLOAT           11      // Single precision (4-byte) IEEE format
 #define DOUBLE          12      // Double precision (8-byte) IEEE format
 
+/**
+ * @brief Tags of Directory Entries pointing at other data of the EXIF Segment
+ * 
+ * Reference: Exif Version 3.0, pp.38-39 and TIFF Revision 6.0, p.117
+ */
+#define TAG_EXIF_IFD        0x8769  // The offset of EXIF IFD
+#define TAG_GPS_IFD         0x8825  // The offset of GPS IFD
+#define TAG_INTEROP_IFD     0xA005  // The offset of Interoperability IFD
+#define TAG_THUMBNAIL       0x0201  // The offset of the JPEG thumbnail
+#define TAG_THUMBNAIL_LEN   0x0202  // The length of the JPEG thumbnail
+
+/**
+ * @brief Tags of the GPS IFD decoded by `exif_gps`
+ * 
+ * Reference: Exif Version 3.0, pp.90-91
+ */
+#define TAG_GPS_LATITUDE_REF    0x0001  // 'N' or 'S'
+#define TAG_GPS_LATITUDE        0x0002  // Degrees, minutes and seconds as 3 RATIONALs
+#define TAG_GPS_LONGITUDE_REF   0x0003  // 'E' or 'W'
+#define TAG_GPS_LONGITUDE       0x0004  // Degrees, minutes and seconds as 3 RATIONALs
+#define TAG_GPS_ALTITUDE_REF    0x0005  // 0 or 2 above, 1 or 3 below the reference
+#define TAG_GPS_ALTITUDE        0x0006  // Meters as a RATIONAL
+#define TAG_GPS_TIME_STAMP      0x0007  // Hours, minutes and seconds as 3 RATIONALs
+#define TAG_GPS_DATE_STAMP      0x001D  // "YYYY:MM:DD"
+
+/**
+ * @brief Maximum number of chained TIFF IFDs, guarding against cycles in malformed files
+ */
+#define EXIF_MAX_CHAIN      16
+
+/**
+ * @brief Maximum number of IFDs of an EXIF Segment (the 0th IFD chain, EXIF IFD and GPS IFD)
+ */
+#define EXIF_MAX_IFDS       (EXIF_MAX_CHAIN + 2)
+
+/**
+ * @brief Index of an absent IFD
+ */
+#define EXIF_NO_IFD         0xFFFF
+
+/**
+ * @brief Flag of a VALUE OFFSET into the value pool of the EXIF Directory rather than from IFH
+ */
+#define EXIF_POOL           0x80000000
+
 /**
  * @brief EXIF Segment representation
  */
 struct EXIF_Segment {
-    uint8_t *IFH_Base;                      // The pointer to the first byte of IFH
-    struct Image_File_Directory *Next_IFD;  // The pointer to the next IFD
-    struct Image_File_Directory *EXIF_IFD;  // The pointer to the EXIF IFD
-    struct Image_File_Directory *GPS_IFD;   // The pointer to the GPS IFD
+    uint8_t               *IFH_Base;        // The pointer to the first byte of IFH
+    bool                  Byte_Swap;        // Whether the byte order of IFH differs from the host
+    struct EXIF_Directory *Dir;             // The IFDs, DEs and patched values
+    uint32_t              Dir_Capacity;     // The number of bytes allocated to the EXIF Directory
+    uint8_t               *APP1_Base;       // The pointer to MARKER of the APP1 Marker Segment
+    uint32_t              APP1_Length;      // The length of the APP1 Marker Segment including MARKER
+    uint8_t               *APP1_New;        // The rebuilt APP1 Marker Segment including MARKER
+    uint32_t              APP1_New_Length;  // The length of the rebuilt APP1 Marker Segment
+    struct Filter_State   *Filter;          // The predicate evaluated on each DE, or NULL
 };
 
 /**
  * @brief Image File Directory representation
  */
 struct Image_File_Directory {
-    uint16_t DE_Count;                      // The number of DEs
-    struct Image_File_Directory *Next_IFD;  // The pointer to the next IFD
-    struct Directory_Entry      *DEs;       // The pointer to the first DE
+    uint32_t First_DE;      // The index of the first DE in the EXIF Directory
+    uint16_t DE_Count;      // The number of DEs
+    uint16_t Next_IFD;      // The index of the next IFD of the chain, or EXIF_NO_IFD
 };
 
 /**
- * @brief Directory Entry representation
+ * @brief Directory Entry representation, as compact as in the file
  */
 struct Directory_Entry {
     uint16_t Tag;           // The tag of the DE
     uint16_t Value_Type;    // The type of values
-    uint16_t Value_Count;   // The number of values
-    uint8_t *Value;         // The pointer to the first value of the DE
+    uint32_t Value_Count;   // The number of values
+    uint32_t Value_Offset;  // The offset of the first value from IFH, or into the value pool with EXIF_POOL
+};
+
+/**
+ * @brief Parse result of an EXIF Segment, in a single allocation
+ * 
+ * The struct is followed by `DE_Count` DEs and `Pool_Length` bytes of values set by patches. The DEs of each IFD
+ * are contiguous and the IFDs are laid out in index order. Holding no pointers, the EXIF Directory can be copied or
+ * persisted as is and used with any copy of the APP1 Marker Segment it was constructed from.
+ */
+struct EXIF_Directory {
+    uint32_t                    Size;                   // The number of bytes of the struct, DEs and value pool
+    uint32_t                    DE_Count;               // The number of DEs of every IFD
+    uint32_t                    Pool_Length;            // The number of bytes of the value pool
+    uint16_t                    IFD_Count;              // The number of IFDs, the 0th IFD being at index 0
+    uint16_t                    EXIF_IFD;               // The index of the EXIF IFD, or EXIF_NO_IFD
+    uint16_t                    GPS_IFD;                // The index of the GPS IFD, or EXIF_NO_IFD
+    uint16_t                    Dirty;                  // Whether the IFDs were changed in a way requiring a rebuild
+    struct Image_File_Directory IFDs[EXIF_MAX_IFDS];    // The IFDs
 };
 
 /**
@@ -98,6 +171,9 @@ void exif_free(struct EXIF_Segment *seg);
  * @param seg      The pointer to the EXIF Segment struct
  * @param idx      The index of the Image File Directory struct to be parsed (0 = TIFF IFD, 1 = EXIF IFD, 2 = GPS IFD)
  * @param ifd_ofst The offset of the Image File Directory from the first byte of Image File Header
+ * 
+ * @note With a filter attached, the construction stops as soon as the filter rejects the file, leaving the
+ *       remaining DEs and IFDs out.
  */
 void ifd_construct(struct EXIF_Segment *seg, uint8_t idx, uint32_t ifd_ofst);
 
@@ -109,4 +185,82 @@ void ifd_construct(struct EXIF_Segment *seg, uint8_t idx, uint32_t ifd_ofst);
  */
 void ifd_parse(struct EXIF_Segment *seg, uint8_t idx);
 
+/**
+ * @brief Set the values of a Directory Entry, overwriting them in place when they fit.
+ * 
+ * @param seg   The pointer to the EXIF Segment struct
+ * @param idx   The index of the Image File Directory (0 = TIFF IFD, 1 = EXIF IFD, 2 = GPS IFD)
+ * @param tag   The tag of the Directory Entry
+ * @param type  The type of values
+ * @param count The number of values
+ * @param value The pointer to the values in host byte order
+ * 
+ * @return JPEG_OK if overwritten in place, JPEG_REBUILD if the APP1 Marker Segment has to be rebuilt, JPEG_ERROR otherwise
+ */
+int exif_set(struct EXIF_Segment *seg, uint8_t idx, uint16_t tag, uint16_t type, uint32_t count, const void *value);
+
+/**
+ * @brief Remove a Directory Entry, together with the IFD it points to if any.
+ * 
+ * @param seg The pointer to the EXIF Segment struct
+ * @param idx The index of the Image File Directory (0 = TIFF IFD, 1 = EXIF IFD, 2 = GPS IFD)
+ * @param tag The tag of the Directory Entry
+ * 
+ * @return JPEG_REBUILD if removed, JPEG_ERROR if absent
+ */
+int exif_remove(struct EXIF_Segment *seg, uint8_t idx, uint16_t tag);
+
+/**
+ * @brief Retain only the given Directory Entries of the 0th IFD, dropping every other IFD.
+ * 
+ * @param seg       The pointer to the EXIF Segment struct
+ * @param tags      The tags of the Directory Entries to be retained
+ * @param tag_count The number of tags
+ * 
+ * @return The number of Directory Entries retained
+ */
+uint16_t exif_retain(struct EXIF_Segment *seg, const uint16_t *tags, uint16_t tag_count);
+
+/**
+ * @brief Serialize the IFDs into a new APP1 Marker Segment.
+ * 
+ * @param seg The pointer to the EXIF Segment struct
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the result does not fit in a Marker Segment
+ * 
+ * @note The Interoperability IFD is dropped and MakerNote is copied verbatim.
+ */
+int exif_rebuild(struct EXIF_Segment *seg);
+
+/**
+ * @brief Decode the position and time of the GPS IFD.
+ * 
+ * @param seg The pointer to the EXIF Segment struct
+ * @param gps The pointer to the JPEG GPS struct to be filled
+ * 
+ * @return JPEG_OK if any field was decoded, JPEG_ERROR otherwise
+ */
+int exif_gps(const struct EXIF_Segment *seg, struct JPEG_GPS *gps);
+
+/**
+ * @brief Construct an EXIF Segment struct from an EXIF Directory exported by another one.
+ * 
+ * @param seg      The pointer to the EXIF Segment struct
+ * @param app1     The pointer to MARKER of the APP1 Marker Segment the EXIF Directory was constructed from
+ * @param app1_len The number of bytes available at `app1`, which must hold the whole APP1 Marker Segment
+ * @param dir      The pointer to the EXIF Directory
+ * @param len      The number of bytes of the EXIF Directory
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the EXIF Directory is inconsistent with itself or the APP1 Marker Segment
+ */
+int exif_attach(struct EXIF_Segment *seg, uint8_t *app1, size_t app1_len, const void *dir, size_t len);
+
+/**
+ * @brief Evaluate a predicate on the IFDs of an EXIF Segment struct constructed without a filter.
+ * 
+ * @param seg   The pointer to the EXIF Segment struct
+ * @param state The pointer to the Filter State struct, initialized by `filter_init`
+ */
+void exif_filter(const struct EXIF_Segment *seg, struct Filter_State *state);
+
 #endif /* EXIF_H */
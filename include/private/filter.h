@@ -0,0 +1,143 @@
+/**
+ * @file   filter.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Functions to compile and evaluate predicates over EXIF tags while the IFDs are constructed.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Limits of a compiled predicate
+ */
+#define FILTER_MAX_ATOMS    32      // The maximum number of comparisons and existence tests
+#define FILTER_MAX_CODE     64      // The maximum length of the postfix program
+#define FILTER_MAX_STRING   64      // The maximum length of a string literal, including the null byte
+
+/**
+ * @brief Operators of an atom
+ */
+#define FILTER_OP_HAS       0       // The tag is present
+#define FILTER_OP_EQ        1       // =
+#define FILTER_OP_NE        2       // !=
+#define FILTER_OP_LT        3       // <
+#define FILTER_OP_LE        4       // <=
+#define FILTER_OP_GT        5       // >
+#define FILTER_OP_GE        6       // >=
+
+/**
+ * @brief Connectives of the postfix program (other codes are atom indices)
+ */
+#define FILTER_CODE_AND     0xFD
+#define FILTER_CODE_OR      0xFE
+#define FILTER_CODE_NOT     0xFF
+
+/**
+ * @brief Sets of possible truth values (three-valued logic, UNKNOWN when a compared tag is absent)
+ */
+#define FILTER_FALSE        0x01
+#define FILTER_TRUE         0x02
+#define FILTER_UNKNOWN      0x04
+#define FILTER_PENDING      0x07    // The tag has not been reached yet, so any value is possible
+
+/**
+ * @brief Comparison or existence test on a single tag
+ */
+struct Filter_Atom {
+    uint8_t  IFD;                       // The index of the IFD (0 = TIFF IFD, 1 = EXIF IFD, 2 = GPS IFD)
+    uint16_t Tag;                       // The tag of the DE
+    uint8_t  Op;                        // One of FILTER_OP_*
+    bool     Is_String;                 // Whether the operand is a string literal
+    double   Number;                    // The numeric operand
+    char     String[FILTER_MAX_STRING]; // The string operand
+};
+
+/**
+ * @brief Compiled predicate, shared read-only by every file it is evaluated on
+ */
+struct JPEG_Filter {
+    struct Filter_Atom Atoms[FILTER_MAX_ATOMS];  // The atoms
+    uint8_t            Atom_Count;               // The number of atoms
+    uint8_t            Code[FILTER_MAX_CODE];    // The expression in postfix order
+    uint8_t            Code_Length;              // The length of the postfix program
+};
+
+/**
+ * @brief Value of a DE as seen by the filter
+ */
+struct Filter_Value {
+    bool       Valid;       // Whether the value lies within the EXIF Segment and has a supported type
+    bool       Is_String;   // Whether the value is ASCII or UNDEFINED
+    double     Number;      // The first value of a numeric DE
+    const char *String;     // The first byte of an ASCII or UNDEFINED DE
+    uint32_t   Length;      // The number of bytes of an ASCII or UNDEFINED DE
+};
+
+/**
+ * @brief Evaluation state of a predicate on a single file
+ */
+struct Filter_State {
+    const struct JPEG_Filter *Filter;                   // The compiled predicate
+    uint8_t                  Values[FILTER_MAX_ATOMS];  // The possible truth values of each atom
+    uint8_t                  Outcome;                   // The possible truth values of the predicate
+};
+
+/**
+ * @brief Compile the given expression.
+ * 
+ * @param expr The expression, e.g. "Make = 'Canon' AND ISO > 3200 AND has GPS"
+ * 
+ * @return The compiled predicate, or NULL if the expression is malformed
+ */
+struct JPEG_Filter *filter_compile(const char *expr);
+
+/**
+ * @brief Free the given compiled predicate.
+ * 
+ * @param filter The pointer to the compiled predicate
+ */
+void filter_free(struct JPEG_Filter *filter);
+
+/**
+ * @brief Start the evaluation of a predicate on a file, with every atom pending.
+ * 
+ * @param state  The pointer to the Filter State struct
+ * @param filter The pointer to the compiled predicate
+ */
+void filter_init(struct Filter_State *state, const struct JPEG_Filter *filter);
+
+/**
+ * @brief Resolve the atoms on the given DE.
+ * 
+ * @param state The pointer to the Filter State struct
+ * @param idx   The index of the IFD holding the DE
+ * @param tag   The tag of the DE
+ * @param val   The value of the DE
+ */
+void filter_entry(struct Filter_State *state, uint8_t idx, uint16_t tag, const struct Filter_Value *val);
+
+/**
+ * @brief Resolve the pending atoms on the given IFD as absent.
+ * 
+ * @param state The pointer to the Filter State struct
+ * @param idx   The index of the IFD which is complete or missing
+ */
+void filter_ifd_done(struct Filter_State *state, uint8_t idx);
+
+/**
+ * @brief Check whether the predicate can no longer be true.
+ * 
+ * @param state The pointer to the Filter State struct, or NULL
+ * 
+ * @return true if the file can be rejected, false otherwise or if `state` is NULL
+ */
+bool filter_rejected(const struct Filter_State *state);
+
+#endif /* FILTER_H */
@@ -0,0 +1,56 @@
+/**
+ * @file   hash.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Streaming 64-bit hash (XXH64) over discontiguous byte ranges.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Hash state representation
+ * 
+ * Reference: xxHash fast digest algorithm, XXH64 specification v0.1.1
+ */
+struct Hash_State {
+    uint64_t Total_Len;     // The number of bytes hashed so far
+    uint64_t Acc[4];        // The accumulators of the four lanes
+    uint8_t  Mem[32];       // The bytes not yet forming a full stripe
+    uint32_t Mem_Len;       // The number of bytes in `Mem`
+    uint64_t Seed;          // The seed
+};
+
+/**
+ * @brief Reset the given Hash State struct.
+ * 
+ * @param state The pointer to the Hash State struct
+ * @param seed  The seed
+ */
+void hash_init(struct Hash_State *state, uint64_t seed);
+
+/**
+ * @brief Hash the given byte range, continuing from the previous ranges.
+ * 
+ * @param state The pointer to the Hash State struct
+ * @param ptr   The pointer to the byte range
+ * @param len   The length of the byte range
+ */
+void hash_update(struct Hash_State *state, const uint8_t *ptr, size_t len);
+
+/**
+ * @brief Obtain the digest of all the byte ranges hashed so far.
+ * 
+ * @param state The pointer to the Hash State struct
+ * 
+ * @return The 64-bit digest
+ */
+uint64_t hash_digest(const struct Hash_State *state);
+
+#endif /* HASH_H */
@@ -0,0 +1,95 @@
+/**
+ * @file   icc.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Functions to reassemble and parse ICC Segments.
+ */
+
+#ifndef ICC_H
+#define ICC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jpeg.h"
+
+/**
+ * @brief Maximum number of ICC Segments (the sequence number is a single byte)
+ * 
+ * Reference: ICC.1:2010, Annex B.4
+ */
+#define ICC_MAX_CHUNKS  255
+
+/**
+ * @brief ICC Segment representation
+ * 
+ * A profile larger than a single APP2 is split into numbered chunks. Each chunk is kept as a view
+ * into the source byte array, indexed by its sequence number, so no profile byte is copied.
+ */
+struct ICC_Segment {
+    uint8_t          Chunk_Count;               // The number of chunks declared by the chunks
+    uint8_t          Chunk_Found;               // The number of distinct chunks found so far
+    struct JPEG_View Chunks[ICC_MAX_CHUNKS];    // The views of the chunk payloads (index = sequence number - 1)
+};
+
+/**
+ * @brief Construct an ICC Segment struct by adding the chunk in the given byte array.
+ * 
+ * @param seg The pointer to the ICC Segment struct
+ * @param ptr The pointer to the pointer to the byte array
+ * 
+ * @note Parameter `ptr` will be advanced by the length of the APP2 Marker Segment.
+ */
+void icc_construct(struct ICC_Segment *seg, uint8_t **ptr);
+
+/**
+ * @brief Parse the given ICC Segment struct.
+ * 
+ * @param seg The pointer to the ICC Segment struct
+ */
+void icc_parse(struct ICC_Segment *seg);
+
+/**
+ * @brief Free the memory dynamically allocated to the given ICC Segment struct.
+ * 
+ * @param seg The pointer to the ICC Segment struct
+ */
+void icc_free(struct ICC_Segment *seg);
+
+/**
+ * @brief Obtain the views of the chunks in sequence order.
+ * 
+ * @param seg   The pointer to the ICC Segment struct
+ * @param views The array to be filled with views
+ * @param max   The capacity of `views`
+ * 
+ * @return The number of views, or 0 if a chunk is missing or `max` is too small
+ */
+size_t icc_views(const struct ICC_Segment *seg, struct JPEG_View *views, size_t max);
+
+/**
+ * @brief Gather bytes of the reassembled profile without reassembling it.
+ * 
+ * @param seg  The pointer to the ICC Segment struct
+ * @param ofst The offset from the first byte of the profile
+ * @param dst  The destination buffer
+ * @param len  The number of bytes to be gathered
+ * 
+ * @return The number of bytes gathered, which is less than `len` past the end of the profile
+ */
+size_t icc_read(const struct ICC_Segment *seg, size_t ofst, void *dst, size_t len);
+
+/**
+ * @brief Parse the profile header and description tag.
+ * 
+ * @param seg  The pointer to the ICC Segment struct
+ * @param info The pointer to the ICC Profile Info struct to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR otherwise
+ */
+int icc_info(const struct ICC_Segment *seg, struct ICC_Profile_Info *info);
+
+#endif /* ICC_H */
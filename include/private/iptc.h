@@ -0,0 +1,108 @@
+/**
+ * @file   iptc.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Functions to parse IPTC Segment.
+ */
+
+#ifndef IPTC_H
+#define IPTC_H
+
+#include <stdint.h>
+
+/**
+ * @brief Photoshop image resource ID of the IPTC-NAA record
+ * 
+ * Reference: Adobe Photoshop File Formats Specification, Image Resource IDs
+ */
+#define IPTC_RESOURCE_ID    0x0404
+
+/**
+ * @brief IPTC Segment representation
+ * 
+ * The image resources of a file may be spread over several APP13 Marker Segments, so the IPTC-NAA records of
+ * every one are collected, in file order, as views into the source byte array.
+ */
+struct IPTC_Segment {
+    uint16_t            Dataset_Count;      // The number of decoded datasets of every APP13 Marker Segment so far
+    struct IPTC_Dataset *Datasets;          // The pointer to the first decoded dataset
+    const uint16_t      *Projection;        // The keys to be decoded, or NULL to decode all datasets
+    uint16_t            Projection_Count;   // The number of keys to be decoded
+};
+
+/**
+ * @brief IPTC dataset representation
+ */
+struct IPTC_Dataset {
+    uint16_t Key;       // The record number in the high byte and the dataset number in the low byte
+    uint32_t Length;    // The number of bytes of the value
+    uint8_t  *Value;    // The pointer to the first byte of the value
+};
+
+/**
+ * @brief Find a dataset of the given IPTC Segment struct.
+ * 
+ * @param seg The pointer to the IPTC Segment struct
+ * @param key The key of the dataset
+ * @param nth The occurrence of a repeatable dataset (0 = first)
+ * 
+ * @return The pointer to the dataset, or NULL if it is absent or not decoded
+ */
+const struct IPTC_Dataset *iptc_find(const struct IPTC_Segment *seg, uint16_t key, uint16_t nth);
+
+/**
+ * @brief Obtain the type IPTC-IIM defines for the dataset of the given key.
+ * 
+ * @return One of IPTC_TYPE_*
+ */
+uint8_t iptc_type(uint16_t key);
+
+/**
+ * @brief Decode a dataset of type IPTC_TYPE_SHORT or IPTC_TYPE_DIGITS.
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is of another type or malformed
+ */
+int iptc_int(const struct IPTC_Dataset *ds, int32_t *val);
+
+/**
+ * @brief Decode a dataset of type IPTC_TYPE_DATE as "YYYY:MM:DD".
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is of another type or malformed
+ */
+int iptc_date(const struct IPTC_Dataset *ds, char date[11]);
+
+/**
+ * @brief Decode a dataset of type IPTC_TYPE_TIME into seconds since midnight and minutes from UTC.
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is of another type or malformed
+ */
+int iptc_time(const struct IPTC_Dataset *ds, int32_t *time, int16_t *offset);
+
+/**
+ * @brief Construct an IPTC Segment struct by adding the datasets of the APP13 Marker Segment in the given byte array.
+ * 
+ * @param seg The pointer to the IPTC Segment struct, whose projection is already set
+ * @param ptr The pointer to the pointer to the byte array
+ * 
+ * @note Parameter `ptr` will be advanced by the length of the APP13 Marker Segment.
+ */
+void iptc_construct(struct IPTC_Segment *seg, uint8_t **ptr);
+
+/**
+ * @brief Parse the given IPTC Segment struct.
+ * 
+ * @param seg The pointer to the IPTC Segment struct
+ */
+void iptc_parse(struct IPTC_Segment *seg);
+
+/**
+ * @brief Free the memory dynamically allocated to the given IPTC Segment struct.
+ * 
+ * @param seg The pointer to the IPTC Segment struct
+ */
+void iptc_free(struct IPTC_Segment *seg);
+
+#endif /* IPTC_H */
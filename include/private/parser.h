@@ -0,0 +1,84 @@
+/**
+ * @file   parser.h
+ * 
+ * @author Yiyang Yan
+ * 
+ * @date   2024/07/20
+ * 
+ * @brief  Functions to reassemble Marker Segments from byte arrays received in chunks.
+ */
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jpeg.h"
+
+/**
+ * @brief States of the Marker Segment walk
+ */
+#define PARSER_SOI      0   // Receiving SOI
+#define PARSER_HEADER   1   // Receiving MARKER and LENGTH
+#define PARSER_BODY     2   // Receiving a Marker Segment to be constructed
+#define PARSER_SKIP     3   // Skipping a Marker Segment of other applications
+#define PARSER_DONE     4   // The APP Marker Segments are over
+#define PARSER_ERROR    5   // The byte array is malformed
+
+/**
+ * @brief Number of zeroed bytes past the end of each buffer, as constructors read fixed-size headers before
+ *        checking LENGTH
+ */
+#define PARSER_PADDING  16
+
+/**
+ * @brief Push parser representation
+ * 
+ * Only the Marker Segments constructed by the library are buffered, each in its own allocation, since the
+ * constructed segments refer to their bytes. Other Marker Segments are skipped as they arrive.
+ */
+struct JPEG_Parser {
+    struct JPEG *JPEG;              // The JPEG struct being constructed
+    uint8_t     State;              // One of PARSER_*
+    uint8_t     Header[4];          // MARKER and LENGTH of the current Marker Segment
+    uint8_t     Header_Length;      // The number of bytes of `Header` received
+    uint8_t     *Segment;           // The buffer of the current Marker Segment, or NULL if not buffered
+    uint32_t    Segment_Length;     // The length of the current Marker Segment including MARKER
+    uint32_t    Received;           // The number of bytes of the current Marker Segment received or skipped
+    uint8_t     **Buffers;          // The buffers referred to by the JPEG struct
+    size_t      Buffer_Count;       // The number of buffers
+};
+
+/**
+ * @brief Consume bytes of the given chunk until a Marker Segment is complete.
+ * 
+ * @param parser The pointer to the JPEG Parser struct
+ * @param chunk  The pointer to the pointer to the chunk, advanced past the consumed bytes
+ * @param len    The pointer to the number of bytes left in the chunk, decreased accordingly
+ * @param seg    The pointer to be set to MARKER of the complete Marker Segment
+ * 
+ * @return JPEG_OK if a Marker Segment is complete, to be released with `parser_release`,
+ *         JPEG_NEED_MORE_DATA if the chunk is consumed, or JPEG_ERROR if the byte array is malformed
+ * 
+ * @note Past the APP Marker Segments, only MARKER of the first other Marker Segment is returned.
+ */
+int parser_next(struct JPEG_Parser *parser, const uint8_t **chunk, size_t *len, uint8_t **seg);
+
+/**
+ * @brief Release the Marker Segment returned by `parser_next`.
+ * 
+ * @param parser The pointer to the JPEG Parser struct
+ * @param keep   Whether the JPEG struct refers to the bytes of the Marker Segment
+ */
+void parser_release(struct JPEG_Parser *parser, bool keep);
+
+/**
+ * @brief Free the memory dynamically allocated to the given JPEG Parser struct.
+ * 
+ * @param parser The pointer to the JPEG Parser struct
+ */
+void parser_free(struct JPEG_Parser *parser);
+
+#endif /* PARSER_H */
@@ -21,7 +21,7 @@ struct Tag {
     uint16_t Number;  /* The tag number in hexadecimal */
 };
 
-static struct Tag tags[] = {
+static struct Tag tags[] __attribute__((unused)) = {
     /* Baseline and Extension Tags [TIFF Rev 6.0, pp.117-118] */
     {"Image Width",                     0x0100},    // The image width
     {"Image Height",                    0x0101},    // The image height
@@ -116,4 +116,34 @@ static struct Tag tags[] = {
     {"GPS H Positioning Error",         0x001F}     // The horizontal positioning error
 };
 
+static struct Tag iptc_tags[] __attribute__((unused)) = {
+    /* Envelope Record [IPTC-IIM v4.2, pp.21-30] (Number = RECORD << 8 | DATASET) */
+    {"Coded Character Set",             0x015A},    // The character set designation (ESC % G = UTF-8)
+
+    /* Application Record [IPTC-IIM v4.2, pp.32-50] */
+    {"Record Version",                  0x0200},    // The version of the Application Record (binary SHORT)
+    {"Object Name",                     0x0205},    // The shorthand reference for the object
+    {"Urgency",                         0x020A},    // 1 = Most urgent. 5 = Normal. 8 = Least urgent.
+    {"Category",                        0x020F},    // The subject of the object (deprecated)
+    {"Supplemental Category",           0x0214},    // The supplemental category (repeatable)
+    {"Keywords",                        0x0219},    // The keyword (repeatable)
+    {"Special Instructions",            0x0228},    // The editorial instructions
+    {"Date Created",                    0x0237},    // The date the intellectual content was created (CCYYMMDD)
+    {"Time Created",                    0x023C},    // The time the intellectual content was created (HHMMSS±HHMM)
+    {"By-line",                         0x0250},    // The name of the creator (repeatable)
+    {"By-line Title",                   0x0255},    // The title of the creator (repeatable)
+    {"City",                            0x025A},    // The city of origin
+    {"Sub-location",                    0x025C},    // The location within the city
+    {"Province/State",                  0x025F},    // The province or state of origin
+    {"Country Code",                    0x0264},    // The ISO 3166 country code of origin
+    {"Country Name",                    0x0265},    // The country of origin
+    {"Original Transmission Reference", 0x0267},    // The job identifier
+    {"Headline",                        0x0269},    // The synopsis of the contents
+    {"Credit",                          0x026E},    // The provider of the object
+    {"Source",                          0x0273},    // The original owner of the intellectual content
+    {"Copyright Notice",                0x0274},    // The copyright notice
+    {"Caption/Abstract",                0x0278},    // The textual description of the object
+    {"Writer/Editor",                   0x027A}     // The name of the person involved in the caption (repeatable)
+};
+
 #endif /* TAGS_H */
\ No newline at end of file
@@ -11,15 +11,182 @@
 #ifndef JPEG_H
 #define JPEG_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/**
+ * @brief Return codes of the query functions
+ */
+#define JPEG_OK             0   // Success
+#define JPEG_ERROR          -1  // Absent, incomplete or malformed data
+#define JPEG_REBUILD        1   // Success, but the segment has to be rebuilt
+#define JPEG_NEED_MORE_DATA 2   // The byte array ends before the requested data
+#define JPEG_EXIF_READY     3   // The EXIF Segment was constructed, and more data is needed for the rest
+#define JPEG_DONE           4   // The APP Marker Segments are over, and no more data is needed
+
+/**
+ * @brief Image File Directory indices
+ */
+#define EXIF_IFD_TIFF       0   // 0th IFD
+#define EXIF_IFD_EXIF       1   // EXIF IFD
+#define EXIF_IFD_GPS        2   // GPS IFD
+
+/**
+ * @brief Directory Entry field types
+ * 
+ * Reference: TIFF Revision 6.0, pp.15-16
+ */
+#define EXIF_TYPE_BYTE      1
+#define EXIF_TYPE_ASCII     2
+#define EXIF_TYPE_SHORT     3
+#define EXIF_TYPE_LONG      4
+#define EXIF_TYPE_RATIONAL  5
+#define EXIF_TYPE_UNDEFINED 7
+#define EXIF_TYPE_SLONG     9
+#define EXIF_TYPE_SRATIONAL 10
+
+/**
+ * @brief ICC profile kinds recognized from the profile description
+ */
+#define ICC_KIND_UNKNOWN    0   // Not recognized
+#define ICC_KIND_SRGB       1   // sRGB IEC61966-2.1
+#define ICC_KIND_DISPLAY_P3 2   // Display P3
+#define ICC_KIND_ADOBE_RGB  3   // Adobe RGB (1998)
+
+/**
+ * @brief Encoders recognized from the quantization tables and the APP Marker Segments
+ * 
+ * Only JPEG_ENCODER_LIBJPEG is identified from the tables themselves. The others are guessed from the APP Marker
+ * Segments that tables not produced by libjpeg come with, which any other encoder may write too.
+ */
+#define JPEG_ENCODER_UNKNOWN    0   // Not recognized
+#define JPEG_ENCODER_LIBJPEG    1   // IJG libjpeg or libjpeg-turbo (tables match the scaled example tables exactly)
+#define JPEG_ENCODER_PHOTOSHOP  2   // Other tables with APP13 "Photoshop 3.0" or APP14 "Adobe", e.g. Adobe Photoshop
+#define JPEG_ENCODER_CAMERA     3   // Other tables with APP1 "Exif" but no Adobe segment, e.g. camera firmware
+
+/**
+ * @brief Metadata kept by `jpeg_strip_views` and `jpeg_strip_tail_views` (APP14 "Adobe" and non-APP Marker Segments
+ *        are always kept)
+ */
+#define JPEG_KEEP_JFIF          0x01    // APP0 (JFIF and JFXX)
+#define JPEG_KEEP_EXIF          0x02    // APP1 EXIF Segment
+#define JPEG_KEEP_ORIENTATION   0x04    // APP1 EXIF Segment reduced to Orientation
+#define JPEG_KEEP_XMP           0x08    // APP1 XMP packets
+#define JPEG_KEEP_ICC           0x10    // APP2 ICC Segments
+#define JPEG_KEEP_IPTC          0x20    // APP13 Photoshop resources
+#define JPEG_KEEP_COMMENT       0x40    // COM
+#define JPEG_KEEP_OTHER         0x80    // Other APPs
+#define JPEG_KEEP_TRAILER       0x100   // Data after EOI (e.g. MPF secondary images, with their own metadata)
+
+/**
+ * @brief Fields decoded by `jpeg_gps`
+ */
+#define JPEG_GPS_POSITION       0x01    // Latitude and Longitude
+#define JPEG_GPS_ALTITUDE       0x02    // Altitude
+#define JPEG_GPS_TIME           0x04    // Time
+#define JPEG_GPS_DATE           0x08    // Date
+
+/**
+ * @brief Key of an IPTC dataset
+ * 
+ * Reference: IPTC-IIM v4.2, p.14
+ */
+#define IPTC_KEY(record, dataset)   ((uint16_t)(((record) << 8) | (dataset)))
+
+/**
+ * @brief Types of the IPTC datasets
+ * 
+ * Reference: IPTC-IIM v4.2, pp.21-50
+ */
+#define IPTC_TYPE_BINARY    0   // Octets (e.g. Coded Character Set), and datasets of the other records
+#define IPTC_TYPE_STRING    1   // Graphic characters (e.g. Caption/Abstract)
+#define IPTC_TYPE_SHORT     2   // Binary 16-bit unsigned integer (e.g. Record Version)
+#define IPTC_TYPE_DIGITS    3   // Numeric characters (e.g. Urgency)
+#define IPTC_TYPE_DATE      4   // CCYYMMDD, with 00 for an unknown month or day (e.g. Date Created)
+#define IPTC_TYPE_TIME      5   // HHMMSS±HHMM (e.g. Time Created)
+
 
 /**
  * @brief JPEG file representation
  */
 struct JPEG {
-    void *EXIF_Seg;  // The pointer to the EXIF Segment
-    void *JFIF_Seg;  // The pointer to the JFIF Segment
+    void                     *EXIF_Seg;               // The pointer to the EXIF Segment
+    void                     *JFIF_Seg;               // The pointer to the JFIF Segment
+    void                     *ICC_Seg;                // The pointer to the ICC Segment
+    void                     *IPTC_Seg;               // The pointer to the IPTC Segment
+    const uint16_t           *IPTC_Projection;        // The IPTC keys to be decoded, or NULL to decode all datasets
+    uint16_t                 IPTC_Projection_Count;   // The number of IPTC keys to be decoded
+    const struct JPEG_Filter *Filter;                 // The predicate evaluated while constructing, or NULL
+    void                     *Filter_State;           // The evaluation state of the predicate
+};
+
+/**
+ * @brief View of a contiguous range of the source byte array (same layout as `struct iovec`)
+ */
+struct JPEG_View {
+    const uint8_t *Base;    // The pointer to the first byte of the range
+    size_t        Length;   // The length of the range in bytes
+};
+
+/**
+ * @brief Marker Segment location
+ */
+struct JPEG_Segment {
+    uint16_t Marker;    // The marker (e.g. 0xFFE1 for APP1)
+    size_t   Offset;    // The offset of MARKER from the first byte of the byte array
+    size_t   Length;    // The length of the Marker Segment including MARKER
+};
+
+/**
+ * @brief Frame parameters from the SOFn Marker Segment
+ * 
+ * Reference: ISO/IEC 10918-1:1993, pp.35-37
+ */
+struct JPEG_Info {
+    uint16_t SOF_Marker;        // The SOFn marker (0xFFC0 to 0xFFCF, except DHT, JPG and DAC)
+    uint16_t Width;             // The number of samples per line
+    uint16_t Height;            // The number of lines (0 if defined by a later DNL Marker Segment)
+    uint8_t  Precision;         // The sample precision in bits
+    uint8_t  Component_Count;   // The number of image components
+    uint8_t  Sampling[4];       // The horizontal (high nibble) and vertical (low nibble) sampling factors of the first 4 components
+    uint8_t  Baseline;          // 1 for baseline sequential DCT (SOF0)
+    uint8_t  Progressive;       // 1 for progressive DCT (SOF2, SOF6, SOF10, SOF14)
+    uint8_t  Arithmetic;        // 1 for arithmetic coding (SOF9 onwards)
+    uint8_t  Lossless;          // 1 for lossless (SOF3, SOF7, SOF11, SOF15)
+    size_t   Header_Length;     // The offset past the last Marker Segment the probe depended on
+    uint8_t  Quality;           // The IJG-equivalent quality (1 to 100), 0 if the quantization tables are missing
+    uint8_t  Encoder;           // One of JPEG_ENCODER_*
+    char     Subsampling[8];    // The chroma subsampling (e.g. "4:2:0"), "gray" for a single component
+};
+
+/**
+ * @brief Summary of the ICC profile header and description tag
+ * 
+ * Reference: ICC.1:2010, pp.19-25
+ */
+struct ICC_Profile_Info {
+    uint32_t Size;              // The declared profile size in bytes
+    uint32_t Version;           // The profile version (major in the first byte, minor and bugfix in BCD)
+    char     Class[5];          // The profile/device class signature (e.g. "mntr")
+    char     Color_Space[5];    // The data color space signature (e.g. "RGB ")
+    char     PCS[5];            // The profile connection space signature (e.g. "XYZ ")
+    char     Description[64];   // The profile description in ASCII, truncated if longer
+    uint8_t  Kind;              // One of ICC_KIND_*
+};
+
+/**
+ * @brief Position and time from the GPS IFD, in decimal form
+ * 
+ * Reference: Exif Version 3.0, pp.90-97
+ */
+struct JPEG_GPS {
+    double  Latitude;   // The latitude in degrees, negative for South
+    double  Longitude;  // The longitude in degrees, negative for West
+    double  Altitude;   // The altitude in meters, negative below the reference
+    double  Time;       // The time of day in seconds since midnight UTC
+    char    Date[11];   // The date in UTC as "YYYY:MM:DD"
+    uint8_t Fields;     // The fields decoded (JPEG_GPS_*)
 };
 
 /**
@@ -44,4 +211,391 @@ void jpeg_parse(struct JPEG *jpeg);
  */
 void jpeg_free(struct JPEG *jpeg);
 
+/**
+ * @brief Start constructing a JPEG struct from a byte array to be received in chunks.
+ * 
+ * Each APP Marker Segment constructed by the library is buffered until complete and constructed right away, so the
+ * EXIF Segment (and the filter of the JPEG struct, if set) can be inspected long before the file is received.
+ * Other Marker Segments are skipped as they arrive, and nothing past the APP Marker Segments is read.
+ * 
+ * @param jpeg The pointer to the JPEG struct, zeroed except for the members configuring the construction
+ * 
+ * @return The pointer to the JPEG Parser struct, to be freed by `jpeg_parser_free`
+ */
+struct JPEG_Parser *jpeg_parser_create(struct JPEG *jpeg);
+
+/**
+ * @brief Consume the next chunk of the byte array.
+ * 
+ * @param parser The pointer to the JPEG Parser struct
+ * @param chunk  The pointer to the chunk, which need not outlive the call
+ * @param len    The length of the chunk
+ * 
+ * @return JPEG_DONE once the APP Marker Segments are over or the filter rejected the file, otherwise JPEG_EXIF_READY
+ *         if the EXIF Segment was constructed from this chunk, JPEG_NEED_MORE_DATA, or JPEG_ERROR if the byte array
+ *         is not a JPEG file
+ */
+int jpeg_parser_feed(struct JPEG_Parser *parser, const uint8_t *chunk, size_t len);
+
+/**
+ * @brief Free the given JPEG Parser struct.
+ * 
+ * @param parser The pointer to the JPEG Parser struct
+ * 
+ * @note The JPEG struct refers to the buffers of the parser, so it must be freed first.
+ */
+void jpeg_parser_free(struct JPEG_Parser *parser);
+
+/**
+ * @brief Obtain the ICC profile as views into the source byte array, in chunk sequence order.
+ * 
+ * @param jpeg  The pointer to the JPEG struct
+ * @param views The array to be filled with views
+ * @param max   The capacity of `views`
+ * 
+ * @return The number of views, or 0 if the profile is absent, incomplete or `max` is too small
+ */
+size_t jpeg_icc_views(const struct JPEG *jpeg, struct JPEG_View *views, size_t max);
+
+/**
+ * @brief Copy the ICC profile into a contiguous buffer.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param dst  The destination buffer, or NULL to query the size only
+ * @param cap  The capacity of `dst` in bytes
+ * 
+ * @return The profile size in bytes, or 0 if the profile is absent, incomplete or `cap` is too small
+ */
+size_t jpeg_icc_copy(const struct JPEG *jpeg, uint8_t *dst, size_t cap);
+
+/**
+ * @brief Parse the ICC profile header and description tag without copying the profile.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param info The pointer to the ICC Profile Info struct to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR otherwise
+ */
+int jpeg_icc_info(const struct JPEG *jpeg, struct ICC_Profile_Info *info);
+
+/**
+ * @brief Obtain the value of an IPTC dataset as a view into the source byte array.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param key  The key of the dataset (see IPTC_KEY)
+ * @param nth  The occurrence of a repeatable dataset (0 = first)
+ * @param val  The pointer to the view to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is absent or not decoded
+ */
+int jpeg_iptc_get(const struct JPEG *jpeg, uint16_t key, uint16_t nth, struct JPEG_View *val);
+
+/**
+ * @brief Visit the decoded IPTC datasets in file order.
+ * 
+ * @param jpeg    The pointer to the JPEG struct
+ * @param visitor The function called with the key and value of each dataset
+ * @param arg     The argument passed through to `visitor`
+ */
+void jpeg_iptc_visit(const struct JPEG *jpeg, void (*visitor)(uint16_t key, const struct JPEG_View *val, void *arg), void *arg);
+
+/**
+ * @brief Obtain the type IPTC-IIM defines for a dataset, to decode the values passed to a visitor.
+ * 
+ * @param key The key of the dataset (see IPTC_KEY)
+ * 
+ * @return One of IPTC_TYPE_*, IPTC_TYPE_STRING for the other datasets of the Envelope and Application Records
+ */
+uint8_t jpeg_iptc_type(uint16_t key);
+
+/**
+ * @brief Obtain the value of an IPTC dataset of type IPTC_TYPE_SHORT or IPTC_TYPE_DIGITS.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param key  The key of the dataset (see IPTC_KEY)
+ * @param nth  The occurrence of a repeatable dataset (0 = first)
+ * @param val  The pointer to the integer to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is absent, of another type or malformed
+ */
+int jpeg_iptc_get_int(const struct JPEG *jpeg, uint16_t key, uint16_t nth, int32_t *val);
+
+/**
+ * @brief Copy the value of an IPTC dataset of type IPTC_TYPE_STRING as a null-terminated string.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param key  The key of the dataset (see IPTC_KEY)
+ * @param nth  The occurrence of a repeatable dataset (0 = first)
+ * @param dst  The destination, truncated to `cap - 1` bytes if the value is longer
+ * @param cap  The capacity of the destination in bytes
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is absent, of another type or `cap` is 0
+ */
+int jpeg_iptc_get_string(const struct JPEG *jpeg, uint16_t key, uint16_t nth, char *dst, size_t cap);
+
+/**
+ * @brief Obtain the value of an IPTC dataset of type IPTC_TYPE_DATE as "YYYY:MM:DD", like `struct JPEG_GPS`.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param key  The key of the dataset (see IPTC_KEY)
+ * @param nth  The occurrence of a repeatable dataset (0 = first)
+ * @param date The destination of the date, "00" standing for an unknown month or day
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is absent, of another type or malformed
+ */
+int jpeg_iptc_get_date(const struct JPEG *jpeg, uint16_t key, uint16_t nth, char date[11]);
+
+/**
+ * @brief Obtain the value of an IPTC dataset of type IPTC_TYPE_TIME.
+ * 
+ * @param jpeg   The pointer to the JPEG struct
+ * @param key    The key of the dataset (see IPTC_KEY)
+ * @param nth    The occurrence of a repeatable dataset (0 = first)
+ * @param time   The pointer to the local time of day in seconds since midnight to be filled
+ * @param offset The pointer to the offset of the local time from UTC in minutes to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the dataset is absent, of another type or malformed
+ */
+int jpeg_iptc_get_time(const struct JPEG *jpeg, uint16_t key, uint16_t nth, int32_t *time, int16_t *offset);
+
+/**
+ * @brief Decode the position and time of the GPS IFD.
+ * 
+ * Degrees, minutes and seconds are summed from their fractions without rounding them to integers, and signed
+ * by GPSLatitudeRef, GPSLongitudeRef and GPSAltitudeRef. A field is decoded only if its values lie within the
+ * EXIF Segment, have the types of the specification and no zero denominator, and are in range.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param gps  The pointer to the JPEG GPS struct to be filled
+ * 
+ * @return JPEG_OK if any field was decoded, JPEG_ERROR otherwise
+ * 
+ * @note The GPS IFD is absent if the filter of the JPEG struct rejected the file before it.
+ */
+int jpeg_gps(const struct JPEG *jpeg, struct JPEG_GPS *gps);
+
+/**
+ * @brief Set the values of a Directory Entry of the EXIF Segment.
+ * 
+ * Values of the same type that fit in the space of the current values are overwritten in place (ASCII strings may
+ * shrink and are padded with null bytes). Anything else is applied to the IFDs and the APP1 Marker Segment is
+ * rebuilt by `jpeg_exif_views`.
+ * 
+ * @param jpeg  The pointer to the JPEG struct
+ * @param idx   The index of the Image File Directory (EXIF_IFD_*)
+ * @param tag   The tag of the Directory Entry
+ * @param type  The type of values (EXIF_TYPE_*)
+ * @param count The number of values
+ * @param value The pointer to the values in host byte order
+ * 
+ * @return JPEG_OK if overwritten in place, JPEG_REBUILD if a rebuild is needed, JPEG_ERROR otherwise
+ */
+int jpeg_exif_set(struct JPEG *jpeg, uint8_t idx, uint16_t tag, uint16_t type, uint32_t count, const void *value);
+
+/**
+ * @brief Remove a Directory Entry of the EXIF Segment (e.g. the GPS IFD offset to scrub GPS).
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param idx  The index of the Image File Directory (EXIF_IFD_*)
+ * @param tag  The tag of the Directory Entry
+ * 
+ * @return JPEG_REBUILD if removed, JPEG_ERROR if absent
+ */
+int jpeg_exif_remove(struct JPEG *jpeg, uint8_t idx, uint16_t tag);
+
+/**
+ * @brief Obtain the parse result of the EXIF Segment as a relocatable byte array.
+ * 
+ * The IFDs and their Directory Entries are kept in a single allocation without pointers: IFDs are linked by index and
+ * values are referenced by offsets from IFH. The byte array can be copied, persisted or handed to another thread or
+ * process as is, and attached with `jpeg_exif_attach` to any copy of the APP1 Marker Segment, saving the IFD walk.
+ * 
+ * @param jpeg The pointer to the JPEG struct
+ * @param view The view to be filled, valid until the JPEG struct is freed or patched
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if there is no EXIF Segment
+ */
+int jpeg_exif_export(const struct JPEG *jpeg, struct JPEG_View *view);
+
+/**
+ * @brief Construct the EXIF Segment of a JPEG struct from a parse result obtained with `jpeg_exif_export`.
+ * 
+ * @param jpeg     The pointer to the JPEG struct, without EXIF Segment
+ * @param app1     The pointer to MARKER of the APP1 Marker Segment the parse result was obtained from
+ * @param app1_len The number of bytes available at `app1` (e.g. as received), which must cover its LENGTH
+ * @param dir      The pointer to the parse result, which is copied
+ * @param len      The length of the parse result
+ * 
+ * @return JPEG_OK on success, JPEG_ERROR if the parse result is inconsistent with itself or the APP1 Marker Segment
+ * 
+ * @note The APP1 Marker Segment is written to by in-place patches, like the byte array passed to `jpeg_construct`.
+ */
+int jpeg_exif_attach(struct JPEG *jpeg, uint8_t *app1, size_t app1_len, const void *dir, size_t len);
+
+/**
+ * @brief Describe the patched file as (unchanged prefix, APP1 Marker Segment, unchanged remainder).
+ * 
+ * @param jpeg     The pointer to the JPEG struct
+ * @param file     The pointer to the byte array passed to `jpeg_construct`
+ * @param file_len The length of the byte array
+ * @param views    The array of 3 views to be filled, suitable for `writev`
+ * 
+ * @return The number of views (3), or 0 if there is no EXIF Segment or the rebuild failed
+ * 
+ * @note The APP1 view points into `file` unless a rebuild was needed.
+ */
+size_t jpeg_exif_views(struct JPEG *jpeg, const uint8_t *file, size_t file_len, struct JPEG_View *views);
+
+/**
+ * @brief Locate the Marker Segment at the given offset, without reading past the given length.
+ * 
+ * Fill bytes before MARKER are skipped. For SOS, only the header is covered, not the entropy-coded data.
+ * 
+ * @param ptr  The pointer to the byte array
+ * @param len  The number of bytes available
+ * @param ofst The offset of the Marker Segment (or of its fill bytes)
+ * @param seg  The pointer to the JPEG Segment struct to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_NEED_MORE_DATA if the segment extends past `len`, JPEG_ERROR if there is no marker
+ */
+int jpeg_segment(const uint8_t *ptr, size_t len, size_t ofst, struct JPEG_Segment *seg);
+
+/**
+ * @brief Check that the byte array starts with SOI and holds every APP Marker Segment walked by `jpeg_construct`.
+ * 
+ * `jpeg_construct` trusts LENGTH, so a header read partially (e.g. up to SOFn by `jpeg_probe`) is checked first.
+ * 
+ * @param ptr The pointer to the byte array
+ * @param len The number of bytes available
+ * 
+ * @return true if a Marker Segment other than APPn and COM is reached within `len`
+ */
+bool jpeg_header_complete(const uint8_t *ptr, size_t len);
+
+/**
+ * @brief Describe the header of the file (SOI up to, excluding, SOS) without the unwanted metadata.
+ * 
+ * Adjacent kept Marker Segments are coalesced into a single view. The last view ends at SOS, from where the caller
+ * continues with `jpeg_strip_tail_views`.
+ * 
+ * @param jpeg  The pointer to the JPEG struct constructed from `file`
+ * @param file  The pointer to the byte array passed to `jpeg_construct`
+ * @param len   The number of bytes available, at least up to SOS
+ * @param keep  The metadata to be kept (JPEG_KEEP_*)
+ * @param views The array to be filled with views
+ * @param max   The capacity of `views`
+ * 
+ * @return The number of views, or 0 if SOS is not reached or `max` is too small
+ * 
+ * @note With JPEG_KEEP_ORIENTATION, the EXIF Segment of `jpeg` is reduced in place.
+ */
+size_t jpeg_strip_views(struct JPEG *jpeg, const uint8_t *file, size_t len, uint32_t keep, struct JPEG_View *views, size_t max);
+
+/**
+ * @brief Describe the rest of the file, from SOS up to EOI, without the unwanted metadata.
+ * 
+ * The entropy-coded data is searched for markers, so that APPn and COM between the scans of a progressive or
+ * multi-scan file are stripped like those of the header (APP1 EXIF Segments there are dropped unless JPEG_KEEP_EXIF).
+ * Data after the first EOI, such as appended or MPF secondary images, is dropped unless JPEG_KEEP_TRAILER. A file
+ * truncated within its entropy-coded data is described up to its end, and within a Marker Segment up to its MARKER.
+ * 
+ * @param file     The pointer to the byte array holding the whole file
+ * @param len      The length of the byte array
+ * @param ofst     The offset of SOS, where the last view of `jpeg_strip_views` ends
+ * @param keep     The metadata to be kept (JPEG_KEEP_*)
+ * @param views    The array to be filled with views
+ * @param max      The capacity of `views`
+ * @param complete The pointer to whether EOI was reached, false for a truncated file
+ * 
+ * @return The number of views, or 0 if there is no SOS at `ofst` or `max` is too small
+ */
+size_t jpeg_strip_tail_views(const uint8_t *file, size_t len, size_t ofst, uint32_t keep, struct JPEG_View *views,
+                             size_t max, bool *complete);
+
+/**
+ * @brief Hash the image-defining content of a JPEG file, ignoring its metadata.
+ * 
+ * Every Marker Segment other than APPn and COM (e.g. SOFn, DHT, DQT, DRI, SOS) is hashed together with the
+ * entropy-coded data, up to and including EOI. Files differing only in their metadata share the same digest.
+ * 
+ * @param ptr    The pointer to the byte array holding the whole file
+ * @param len    The length of the byte array
+ * @param digest The pointer to the 64-bit digest (XXH64) to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_NEED_MORE_DATA if EOI is missing, JPEG_ERROR if the file is malformed
+ */
+int jpeg_payload_hash(const uint8_t *ptr, size_t len, uint64_t *digest);
+
+/**
+ * @brief Obtain the frame parameters of a JPEG file, reading as few bytes as possible.
+ * 
+ * The marker walk continues past APPn, DQT and DHT up to SOFn. Besides the MARKER and LENGTH of each Marker Segment,
+ * only the payload of DQT and the identifier of APP1, APP13 and APP14 are read, so on a memory-mapped file only the
+ * pages holding the header are touched. If the quantization tables follow SOFn, the walk continues up to SOS.
+ * 
+ * The quality is estimated by matching the tables against the IJG example tables scaled at every quality, with no
+ * entropy decoding. The encoder is identified by the tables first, then by the APP Marker Segments.
+ * 
+ * @param ptr  The pointer to the byte array
+ * @param len  The number of bytes available
+ * @param info The pointer to the JPEG Info struct to be filled
+ * 
+ * @return JPEG_OK on success, JPEG_NEED_MORE_DATA if SOFn lies past `len`, JPEG_ERROR if there is no SOFn
+ */
+int jpeg_probe(const uint8_t *ptr, size_t len, struct JPEG_Info *info);
+
+/**
+ * @brief Compile a predicate over EXIF tags to be evaluated by `jpeg_construct` as the DEs are decoded.
+ * 
+ * The grammar is, with keywords in any case:
+ * 
+ *     expr := and (OR and)*
+ *     and  := not (AND not)*
+ *     not  := NOT not | ( expr ) | HAS EXIF | HAS GPS | HAS ref | ref op literal
+ *     ref  := [tiff. | exif. | gps.] (name | 0xTAG)
+ *     op   := = | != | < | <= | > | >=
+ * 
+ * A name is a tag name without spaces (e.g. "DateTimeOriginal", or "ISO" for "Photographic Sensitivity").
+ * Without a prefix, the IFD is inferred from the tag. A literal is a number or a quoted string. Comparing an
+ * absent tag is UNKNOWN, and only files for which the predicate is TRUE match.
+ * 
+ * @param expr The expression, e.g. "Make = 'Canon' AND ISO > 3200 AND has GPS"
+ * 
+ * @return The compiled predicate, to be freed by `jpeg_filter_free`, or NULL if the expression is malformed
+ * 
+ * @note The compiled predicate is read-only, so it can be shared by JPEG structs constructed concurrently.
+ */
+struct JPEG_Filter *jpeg_filter_compile(const char *expr);
+
+/**
+ * @brief Free the given compiled predicate.
+ * 
+ * @param filter The pointer to the compiled predicate
+ */
+void jpeg_filter_free(struct JPEG_Filter *filter);
+
+/**
+ * @brief Check whether the JPEG struct constructed with a filter matches it.
+ * 
+ * As soon as the predicate cannot be true, `jpeg_construct` stops, leaving the remaining DEs, IFDs and
+ * Marker Segments out. A file that may still match is constructed in full.
+ * 
+ * @param jpeg The pointer to the JPEG struct whose member `Filter` was set before `jpeg_construct`
+ * 
+ * @return true if the predicate is TRUE or no filter was set, false otherwise
+ */
+bool jpeg_filter_match(const struct JPEG *jpeg);
+
+/**
+ * @brief Evaluate a predicate on a JPEG struct constructed in full, without a filter.
+ * 
+ * This gives the same result as `jpeg_filter_match` after constructing with the filter, without the early exit.
+ * 
+ * @param jpeg   The pointer to the JPEG struct
+ * @param filter The pointer to the compiled predicate
+ * 
+ * @return true if the predicate is TRUE, false otherwise
+ */
+bool jpeg_filter_eval(const struct JPEG *jpeg, const struct JPEG_Filter *filter);
+
 #endif /* JPEG_H */
@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dqt.h"
+
+
+/**
+ * @brief Zigzag sequence of the DCT coefficients, mapping zigzag index to natural index
+ * 
+ * Reference: ISO/IEC 10918-1:1993, p.16
+ */
+static const uint8_t zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/**
+ * @brief Example quantization tables, used by libjpeg scaled by the quality factor
+ * 
+ * Reference: ISO/IEC 10918-1:1993, p.143 (Table K.1 and K.2)
+ */
+static const uint8_t std_lum[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+static const uint8_t std_chroma[64] = {
+    17,  18,  24,  47,  99,  99,  99,  99,
+    18,  21,  26,  66,  99,  99,  99,  99,
+    24,  26,  56,  99,  99,  99,  99,  99,
+    47,  66,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99
+};
+
+/**
+ * @brief Scaling factor libjpeg derives from the quality (jpeg_quality_scaling).
+ */
+static uint32_t ijg_scale(uint8_t quality) {
+    return (quality < 50) ? 5000 / quality : 200 - 2 * quality;
+}
+
+/**
+ * @brief Sum the absolute differences between a table and the standard table scaled the way libjpeg does
+ *        (jpeg_add_quant_table), giving up once the sum exceeds `limit`.
+ * 
+ * libjpeg clamps the scaled values to 255 for baseline files, which have 8-bit tables, and to 32767 otherwise, in
+ * which case tables holding values above 255 are written with 16-bit precision.
+ */
+static uint32_t ijg_distance(const uint16_t *table, bool wide, const uint8_t *std, uint32_t scale, uint32_t limit) {
+    uint32_t max  = wide ? 32767 : 255;
+    uint32_t dist = 0;
+    uint32_t ref  = 0;
+
+    for (uint8_t i = 0; i < 64 && dist <= limit; i++) {
+        ref   = (std[i] * scale + 50) / 100;
+        ref   = (ref < 1) ? 1 : (ref > max) ? max : ref;
+        dist += (table[i] > ref) ? table[i] - ref : ref - table[i];
+    }
+
+    return dist;
+}
+
+bool dqt_construct(struct DQT_Tables *tables, const uint8_t *ptr, size_t len) {
+    const uint8_t *end = ptr + len;
+
+    while (ptr < end) {
+        /* Parse Pq (precision, 0 = 8-bit, 1 = 16-bit) and Tq (destination) */
+        uint8_t precision = ptr[0] >> 4;
+        uint8_t dest      = ptr[0] & 0x0F;
+
+        ptr += 1;
+
+        if (precision > 1 || dest > 3 || ptr + 64 * (precision + 1) > end) {
+            return false;
+        }
+
+        /* Parse Qk, stored in zigzag order */
+        for (uint8_t k = 0; k < 64; k++) {
+            tables->Table[dest][zigzag[k]] = (precision == 0) ? ptr[k] : (ptr[2 * k] << 8) | ptr[2 * k + 1];
+        }
+
+        tables->Present |= 1 << dest;
+        tables->Wide     = (precision == 0) ? tables->Wide & ~(1 << dest) : tables->Wide | (1 << dest);
+        ptr += 64 * (precision + 1);
+    }
+
+    return true;
+}
+
+bool dqt_quality(const struct DQT_Tables *tables, uint8_t lum, int chroma, uint8_t *quality) {
+    uint32_t best_dist = UINT32_MAX;
+    uint32_t dist      = 0;
+
+    /* Find the quality whose scaled standard tables are the closest */
+    for (uint8_t q = 1; q <= 100 && best_dist != 0; q++) {
+        dist = ijg_distance(tables->Table[lum], tables->Wide & (1 << lum), std_lum, ijg_scale(q), best_dist);
+        if (chroma >= 0 && dist < best_dist) {
+            dist += ijg_distance(tables->Table[chroma], tables->Wide & (1 << chroma), std_chroma, ijg_scale(q),
+                                 best_dist - dist);
+        }
+
+        if (dist < best_dist) {
+            best_dist = dist;
+            *quality  = q;
+        }
+    }
+
+    return best_dist == 0;
+}
@@ -10,20 +10,362 @@
 #include "exif.h"
 #include "tags.h"
 
+static uint8_t type_size(uint16_t type);
+
+/**
+ * @brief Obtain the DEs following the EXIF Directory struct.
+ */
+static struct Directory_Entry *dir_entries(const struct EXIF_Directory *dir) {
+    return (struct Directory_Entry *)(dir + 1);
+}
+
+/**
+ * @brief Obtain the value pool following the DEs.
+ */
+static uint8_t *dir_pool(const struct EXIF_Directory *dir) {
+    return (uint8_t *)(dir_entries(dir) + dir->DE_Count);
+}
+
+/**
+ * @brief Make room for the given number of bytes more in the EXIF Directory, which may move it.
+ */
+static void dir_reserve(struct EXIF_Segment *seg, uint32_t extra) {
+    uint32_t need = seg->Dir->Size + extra;
+
+    if (need > seg->Dir_Capacity) {
+        seg->Dir_Capacity = (need > 2 * seg->Dir_Capacity) ? need : 2 * seg->Dir_Capacity;
+        seg->Dir          = realloc(seg->Dir, seg->Dir_Capacity);
+    }
+}
+
+/**
+ * @brief Obtain the position in the EXIF Directory of the IFD specified by the index, or EXIF_NO_IFD if absent.
+ */
+static uint16_t ifd_index(const struct EXIF_Segment *seg, uint8_t idx) {
+    switch (idx) {
+        case 0: return (seg->Dir->IFD_Count != 0) ? 0 : EXIF_NO_IFD;
+        case 1: return seg->Dir->EXIF_IFD;
+        case 2: return seg->Dir->GPS_IFD;
+        default: return EXIF_NO_IFD;
+    }
+}
+
+/**
+ * @brief Obtain the Image File Directory struct specified by the index, or NULL if absent.
+ */
+static struct Image_File_Directory *ifd_select(const struct EXIF_Segment *seg, uint8_t idx) {
+    uint16_t ifd_idx = ifd_index(seg, idx);
+
+    return (ifd_idx != EXIF_NO_IFD) ? &(seg->Dir->IFDs[ifd_idx]) : NULL;
+}
+
+/**
+ * @brief Obtain the next Image File Directory struct of the chain, or NULL at its end.
+ */
+static struct Image_File_Directory *ifd_next(const struct EXIF_Segment *seg, const struct Image_File_Directory *ifd) {
+    return (ifd->Next_IFD != EXIF_NO_IFD) ? &(seg->Dir->IFDs[ifd->Next_IFD]) : NULL;
+}
+
+/**
+ * @brief Obtain the pointer to the first value of a DE, in the APP1 Marker Segment or the value pool.
+ */
+static uint8_t *de_data(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    if (de->Value_Offset & EXIF_POOL) {
+        return dir_pool(seg->Dir) + (de->Value_Offset & ~EXIF_POOL);
+    }
+
+    return seg->IFH_Base + de->Value_Offset;
+}
+
+/**
+ * @brief Obtain the number of bytes from IFH to the end of the EXIF Segment, or 0 if IFH lies past it.
+ */
+static uint32_t tiff_length(const struct EXIF_Segment *seg) {
+    const uint8_t *end = seg->APP1_Base + seg->APP1_Length;
+
+    return (seg->IFH_Base != NULL && seg->IFH_Base <= end) ? (uint32_t)(end - seg->IFH_Base) : 0;
+}
+
+/**
+ * @brief Obtain the number of values of a DE lying within the EXIF Segment or the value pool.
+ */
+static uint32_t de_fit_count(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    uint64_t ofst  = de->Value_Offset & ~EXIF_POOL;
+    uint64_t limit = tiff_length(seg);
+    uint8_t  size  = type_size(de->Value_Type);
+
+    if (de->Value_Offset & EXIF_POOL) {
+        limit = seg->Dir->Pool_Length;
+    }
+
+    if (size == 0 || ofst >= limit) {
+        return 0;
+    }
+
+    return ((limit - ofst) / size < de->Value_Count) ? (limit - ofst) / size : de->Value_Count;
+}
+
+/**
+ * @brief Check whether the values of a DE lie within the EXIF Segment or the value pool.
+ */
+static bool de_fits(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    return de_fit_count(seg, de) == de->Value_Count;
+}
+
+/**
+ * @brief Insert zeroed DEs into an IFD at the given position, shifting the DEs of the following IFDs.
+ */
+static void de_splice(struct EXIF_Segment *seg, uint16_t ifd_idx, uint32_t pos, uint32_t count) {
+    uint32_t              size = count * sizeof(struct Directory_Entry);
+    struct EXIF_Directory *dir = NULL;
+
+    dir_reserve(seg, size);
+    dir = seg->Dir;
+
+    /* Move the following DEs and the value pool */
+    memmove(&(dir_entries(dir)[pos + count]), &(dir_entries(dir)[pos]),
+            dir->Size - sizeof(struct EXIF_Directory) - pos * sizeof(struct Directory_Entry));
+    memset(&(dir_entries(dir)[pos]), 0, size);
+
+    dir->Size     += size;
+    dir->DE_Count += count;
+    dir->IFDs[ifd_idx].DE_Count += count;
+
+    for (uint16_t k = ifd_idx + 1; k < dir->IFD_Count; k++) {
+        dir->IFDs[k].First_DE += count;
+    }
+}
+
+/**
+ * @brief Remove DEs of an IFD at the given position, shifting the DEs of the following IFDs.
+ */
+static void de_cut(struct EXIF_Segment *seg, uint16_t ifd_idx, uint32_t pos, uint32_t count) {
+    uint32_t              size = count * sizeof(struct Directory_Entry);
+    struct EXIF_Directory *dir = seg->Dir;
+
+    /* Move the following DEs and the value pool */
+    memmove(&(dir_entries(dir)[pos]), &(dir_entries(dir)[pos + count]),
+            dir->Size - sizeof(struct EXIF_Directory) - pos * sizeof(struct Directory_Entry) - size);
+
+    dir->Size     -= size;
+    dir->DE_Count -= count;
+    dir->IFDs[ifd_idx].DE_Count -= count;
+
+    for (uint16_t k = ifd_idx + 1; k < dir->IFD_Count; k++) {
+        dir->IFDs[k].First_DE -= count;
+    }
+}
+
+/**
+ * @brief Drop an IFD together with its DEs, renumbering the following IFDs.
+ */
+static void ifd_drop(struct EXIF_Segment *seg, uint16_t ifd_idx) {
+    struct EXIF_Directory *dir = seg->Dir;
+    uint16_t              next = dir->IFDs[ifd_idx].Next_IFD;
+
+    de_cut(seg, ifd_idx, dir->IFDs[ifd_idx].First_DE, dir->IFDs[ifd_idx].DE_Count);
+
+    /* Unlink the IFD from its chain */
+    for (uint16_t k = 0; k < dir->IFD_Count; k++) {
+        if (dir->IFDs[k].Next_IFD == ifd_idx) {
+            dir->IFDs[k].Next_IFD = next;
+        }
+    }
+
+    memmove(&(dir->IFDs[ifd_idx]), &(dir->IFDs[ifd_idx + 1]), (dir->IFD_Count - ifd_idx - 1) * sizeof(struct Image_File_Directory));
+    dir->IFD_Count--;
+
+    /* Renumber the references to the following IFDs */
+    for (uint16_t k = 0; k < dir->IFD_Count; k++) {
+        if (dir->IFDs[k].Next_IFD != EXIF_NO_IFD && dir->IFDs[k].Next_IFD > ifd_idx) {
+            dir->IFDs[k].Next_IFD--;
+        }
+    }
+
+    if (dir->EXIF_IFD == ifd_idx) {
+        dir->EXIF_IFD = EXIF_NO_IFD;
+    } else if (dir->EXIF_IFD != EXIF_NO_IFD && dir->EXIF_IFD > ifd_idx) {
+        dir->EXIF_IFD--;
+    }
+
+    if (dir->GPS_IFD == ifd_idx) {
+        dir->GPS_IFD = EXIF_NO_IFD;
+    } else if (dir->GPS_IFD != EXIF_NO_IFD && dir->GPS_IFD > ifd_idx) {
+        dir->GPS_IFD--;
+    }
+}
+
+/**
+ * @brief Names of the Directory Entry field types, indexed by type
+ */
+static const char *type_names[] = {
+    "", "BYTE", "ASCII", "SHORT", "LONG", "RATIONAL", "SBYTE", "UNDEFINED", "SSHORT", "SLONG", "SRATIONAL", "FLOAT",
+    "DOUBLE"
+};
+
+/**
+ * @brief Read a value of the given size (RATIONAL as two LONGs) in host byte order.
+ */
+static uint64_t value_read(const struct EXIF_Segment *seg, const uint8_t *data, uint8_t size) {
+    switch (size) {
+        case 2:  return (seg->Byte_Swap) ? __builtin_bswap16(*(uint16_t *)data) : *(uint16_t *)data;
+        case 4:  return (seg->Byte_Swap) ? __builtin_bswap32(*(uint32_t *)data) : *(uint32_t *)data;
+        case 8:  return (seg->Byte_Swap) ? __builtin_bswap64(*(uint64_t *)data) : *(uint64_t *)data;
+        default: return *data;
+    }
+}
+
+/**
+ * @brief Format the value of a DE at the given index, which must lie within the EXIF Segment.
+ * 
+ * A RATIONAL is printed as a fraction when its denominator is 0.
+ */
+static void value_format(const struct EXIF_Segment *seg, const struct Directory_Entry *de, uint32_t idx, char *buf, size_t cap) {
+    const uint8_t *data = de_data(seg, de) + (size_t)idx * type_size(de->Value_Type);
+    uint64_t      raw   = value_read(seg, data, type_size(de->Value_Type));
+    uint32_t      num   = 0;
+    uint32_t      den   = 0;
+
+    switch (de->Value_Type) {
+        case BYTE:   snprintf(buf, cap, "%"PRIu8, (uint8_t)raw); break;
+        case SBYTE:  snprintf(buf, cap, "%"PRId8, (int8_t)raw); break;
+        case SHORT:  snprintf(buf, cap, "%"PRIu16, (uint16_t)raw); break;
+        case SSHORT: snprintf(buf, cap, "%"PRId16, (int16_t)raw); break;
+        case LONG:   snprintf(buf, cap, "%"PRIu32, (uint32_t)raw); break;
+        case SLONG:  snprintf(buf, cap, "%"PRId32, (int32_t)raw); break;
+
+        case RATIONAL: {
+            num = value_read(seg, data, 4);
+            den = value_read(seg, data + 4, 4);
+            if (den == 0) {
+                snprintf(buf, cap, "%"PRIu32"/0", num);
+            } else {
+                snprintf(buf, cap, "%f", (double)num / den);
+            }
+            break;
+        }
+
+        case SRATIONAL: {
+            num = value_read(seg, data, 4);
+            den = value_read(seg, data + 4, 4);
+            if (den == 0) {
+                snprintf(buf, cap, "%"PRId32"/0", (int32_t)num);
+            } else {
+                snprintf(buf, cap, "%f", (double)(int32_t)num / (int32_t)den);
+            }
+            break;
+        }
+
+        case FLOAT: {
+            uint32_t bits = raw;
+            float    flt  = 0;
+
+            memcpy(&flt, &bits, 4);
+            snprintf(buf, cap, "%f", flt);
+            break;
+        }
+
+        case DOUBLE: {
+            double dbl = 0;
+
+            memcpy(&dbl, &raw, 8);
+            snprintf(buf, cap, "%f", dbl);
+            break;
+        }
+
+        default: buf[0] = '\0'; break;
+    }
+}
+
+/**
+ * @brief Decode the first value of a DE for the filter, checking that it lies within the EXIF Segment.
+ */
+static void de_value(const struct EXIF_Segment *seg, const struct Directory_Entry *de, struct Filter_Value *val) {
+    uint32_t      tiff_len = tiff_length(seg);
+    const uint8_t *data    = de_data(seg, de);
+    uint64_t      raw      = 0;
+    uint32_t      den      = 0;
+    uint8_t       size     = type_size(de->Value_Type);
+
+    memset(val, 0, sizeof(struct Filter_Value));
+
+    if (size == 0 || de->Value_Count == 0 || (de->Value_Offset & EXIF_POOL) ||
+        (uint64_t)de->Value_Offset + (uint64_t)size * de->Value_Count > tiff_len) {
+        return;
+    }
+
+    /* Read the first value in host byte order (RATIONAL as two LONGs) */
+    raw = value_read(seg, data, size);
+
+    val->Valid = true;
+
+    switch (de->Value_Type) {
+        case ASCII:
+        case UNDEFINED: {
+            val->Is_String = true;
+            val->String    = (const char *)data;
+            val->Length    = de->Value_Count;
+            break;
+        }
+
+        case BYTE:
+        case SHORT:
+        case LONG:      val->Number = raw; break;
+        case SBYTE:     val->Number = (int8_t)raw; break;
+        case SSHORT:    val->Number = (int16_t)raw; break;
+        case SLONG:     val->Number = (int32_t)raw; break;
+        case DOUBLE:    memcpy(&val->Number, &raw, 8); break;
+
+        case FLOAT: {
+            uint32_t bits = raw;
+            float    flt  = 0;
+
+            memcpy(&flt, &bits, 4);
+            val->Number = flt;
+            break;
+        }
+
+        case RATIONAL:
+        case SRATIONAL: {
+            raw = value_read(seg, data, 4);
+            den = value_read(seg, data + 4, 4);
+            val->Valid  = (den != 0);
+            val->Number = (de->Value_Type == RATIONAL) ? (double)(uint32_t)raw / den : (double)(int32_t)raw / (int32_t)den;
+            break;
+        }
+
+        default: val->Valid = false; break;
+    }
+}
 
-static bool need_byte_swap = false;
 
 void exif_construct(struct EXIF_Segment *seg, uint8_t **ptr) {
     uint8_t  *seg_base = NULL;
     uint16_t seg_len   = 0;
     uint32_t ifd_ofst  = 0;
 
+    /* Allocate an empty EXIF Directory, with room for the DEs of a typical camera file */
+    seg->Dir_Capacity  = sizeof(struct EXIF_Directory) + 64 * sizeof(struct Directory_Entry);
+    seg->Dir           = calloc(1, seg->Dir_Capacity);
+    seg->Dir->Size     = sizeof(struct EXIF_Directory);
+    seg->Dir->EXIF_IFD = EXIF_NO_IFD;
+    seg->Dir->GPS_IFD  = EXIF_NO_IFD;
+
     /* Skip MARKER, now pointing at LENGTH */
+    seg->APP1_Base = *ptr;
     *ptr += 2;
     seg_base = *ptr;
 
     /* Parse LENGTH */
     seg_len = __builtin_bswap16(**(uint16_t **)ptr);
+    seg->APP1_Length = seg_len + 2;
+
+    /* Reject an EXIF Segment too short to hold IDENTIFIER and IFH, before reading BYTE ORDER and IFD OFFSET */
+    if (seg_len < 2 + 6 + 8) {
+        printf("Truncated EXIF Segment\n");
+        *ptr = seg_base + seg_len;
+        return;
+    }
 
     /* Skip LENGTH, now pointing at IDENTIFIER */
     *ptr += 2;
@@ -41,15 +383,16 @@ void exif_construct(struct EXIF_Segment *seg, uint8_t **ptr) {
     /* Parse BYTE ORDER */
     switch (**(uint16_t **)ptr) {
         case BYTE_ORDER_MM: {
-            need_byte_swap = true;
+            seg->Byte_Swap = true;
             break;
         }
         case BYTE_ORDER_II: {
-            need_byte_swap = false;
+            seg->Byte_Swap = false;
             break;
         }
         default: {
             printf("Unknown endianess\n");
+            *ptr = seg_base + seg_len;
             return;
         }
     }
@@ -58,10 +401,9 @@ void exif_construct(struct EXIF_Segment *seg, uint8_t **ptr) {
     *ptr += 4;
 
     /* Parse IFD OFFSET */
-    ifd_ofst = (need_byte_swap) ? __builtin_bswap32(**(uint32_t **)ptr) : **(uint32_t **)ptr;
+    ifd_ofst = (seg->Byte_Swap) ? __builtin_bswap32(**(uint32_t **)ptr) : **(uint32_t **)ptr;
 
     /* Construct IFDs */
-    seg->Next_IFD = calloc(1, sizeof(struct Image_File_Directory));
     ifd_construct(seg, 0, ifd_ofst);
 
     /* Skip EXIF Segment */
@@ -80,146 +422,155 @@ void exif_parse(struct EXIF_Segment *seg) {
 }
 
 void exif_free(struct EXIF_Segment *seg) {
-    struct Image_File_Directory *prev_ifd = NULL;
-    struct Image_File_Directory *curr_ifd = seg->Next_IFD;
-
-    while (curr_ifd != NULL) {
-        prev_ifd = curr_ifd;
-        curr_ifd = curr_ifd->Next_IFD;
-        free(prev_ifd->DEs);
-        free(prev_ifd);
-    }
-
-    if (seg->EXIF_IFD != NULL) {
-        free(seg->EXIF_IFD->DEs);
-        free(seg->EXIF_IFD);
-    }
-
-    if (seg->GPS_IFD != NULL) {
-        free(seg->GPS_IFD->DEs);
-        free(seg->GPS_IFD);
-    }
+    free(seg->Dir);
+    free(seg->APP1_New);
 }
 
 void ifd_construct(struct EXIF_Segment *seg, uint8_t idx, uint32_t ifd_ofst) {
-    uint8_t                     *ptr      = seg->IFH_Base + ifd_ofst;
-    uint16_t                    val_ofst  = 0;
-    struct Image_File_Directory *curr_ifd = NULL;
-    struct Directory_Entry      *curr_de  = NULL;
+    uint8_t                *ptr      = seg->IFH_Base + ifd_ofst;
+    uint32_t               tiff_len  = tiff_length(seg);
+    uint32_t               val_ofst  = 0;
+    uint8_t                val_size  = 0;
+    bool                   first_ifd = true;
+    uint8_t                chain_len = 0;
+    uint16_t               de_cnt    = 0;
+    uint16_t               ifd_idx   = EXIF_NO_IFD;
+    uint16_t               prev_idx  = EXIF_NO_IFD;
+    struct Filter_Value    val       = {0};
+    struct Directory_Entry *curr_de  = NULL;
+
+    if (idx > 2) {
+        printf("Unknown IFD index");
+        return;
+    }
 
-    switch (idx) {
-        case 0: {
-            curr_ifd = seg->Next_IFD;
-            break;
-        }
-        case 1: {
-            curr_ifd = seg->EXIF_IFD;
-            break;
-        }
-        case 2: {
-            curr_ifd = seg->GPS_IFD;
+    while (1) {
+        /* Abort if the IFD lies outside of the EXIF Segment */
+        if ((uint64_t)ifd_ofst + 2 > tiff_len || seg->Dir->IFD_Count == EXIF_MAX_IFDS) {
             break;
         }
-        default: {
-            printf("Unknown IFD index");
-            return;
-        }
-    }
 
-    while (1) {
-        /* Parse DE COUNT */
-        curr_ifd->DE_Count = (need_byte_swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
+        /* Parse DE COUNT, leaving out the DEs past the end of the EXIF Segment */
+        de_cnt = (seg->Byte_Swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
+        if ((uint64_t)ifd_ofst + 2 + 12 * de_cnt > tiff_len) {
+            de_cnt = (tiff_len - ifd_ofst - 2) / 12;
+        }
 
         /* Skip DE COUNT, now pointing at the first DE */
         ptr += 2;
 
+        /* Append the IFD, linked from the previous IFD of the chain or from the EXIF Directory */
+        ifd_idx = seg->Dir->IFD_Count++;
+        seg->Dir->IFDs[ifd_idx] = (struct Image_File_Directory){seg->Dir->DE_Count, 0, EXIF_NO_IFD};
+
+        if (prev_idx != EXIF_NO_IFD) {
+            seg->Dir->IFDs[prev_idx].Next_IFD = ifd_idx;
+        } else if (idx == 1) {
+            seg->Dir->EXIF_IFD = ifd_idx;
+        } else if (idx == 2) {
+            seg->Dir->GPS_IFD = ifd_idx;
+        }
+
+        /* Reserve the DEs up front, so that they stay contiguous while the private IFDs are appended */
+        de_splice(seg, ifd_idx, seg->Dir->IFDs[ifd_idx].First_DE, de_cnt);
+
         /* Construct DEs */
-        curr_ifd->DEs = calloc(curr_ifd->DE_Count, sizeof(struct Directory_Entry));
-        for (uint16_t i = 0; i < curr_ifd->DE_Count; i++) {
-            /* Point to the current DE */
-            curr_de = &(curr_ifd->DEs[i]);
+        for (uint16_t i = 0; i < de_cnt; i++) {
+            /* Point to the current DE, the EXIF Directory having possibly moved while constructing a private IFD */
+            curr_de = &(dir_entries(seg->Dir)[seg->Dir->IFDs[ifd_idx].First_DE + i]);
 
             /* Parse and skip TAG */
-            curr_de->Tag = (need_byte_swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
+            curr_de->Tag = (seg->Byte_Swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
             ptr += 2;
 
             /* Parse and skip VALUE TYPE */
-            curr_de->Value_Type = (need_byte_swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
+            curr_de->Value_Type = (seg->Byte_Swap) ? __builtin_bswap16(*(uint16_t *)ptr) : *(uint16_t *)ptr;
             ptr += 2;
 
             /* Parse and skip VALUE COUNT */
-            curr_de->Value_Count = (need_byte_swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
+            curr_de->Value_Count = (seg->Byte_Swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
             ptr += 4;
 
             /* Parse VALUE OFFSET */
-            val_ofst = (need_byte_swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
-
-            /* Determine the source of values */
-            switch (curr_de->Value_Type) {
-                case BYTE:
-                case SBYTE:
-                case ASCII: 
-                case UNDEFINED: {
-                    curr_de->Value = (curr_de->Value_Count <= 4) ? ptr : seg->IFH_Base + val_ofst;
-                    break;
-                }
-
-                case SHORT:
-                case SSHORT: {
-                    curr_de->Value = (curr_de->Value_Count <= 2) ? ptr : seg->IFH_Base + val_ofst;
-                    break;
-                }
-
-                case LONG:
-                case SLONG: {
-                    curr_de->Value = (curr_de->Value_Count <= 1) ? ptr : seg->IFH_Base + val_ofst;
-                    break;
-                }
+            val_ofst = (seg->Byte_Swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
+
+            /* Determine the source of values, VALUE OFFSET itself if they fit in 4 bytes */
+            val_size = type_size(curr_de->Value_Type);
+            if (val_size == 0) {
+                printf("Unknown VALUE TYPE\n");
+                de_cut(seg, ifd_idx, seg->Dir->IFDs[ifd_idx].First_DE + i, de_cnt - i);
+                return;
+            }
 
-                case RATIONAL:
-                case SRATIONAL:
-                case FLOAT:
-                case DOUBLE: {
-                    curr_de->Value = seg->IFH_Base + val_ofst;
-                    break;
-                }
+            if ((uint64_t)val_size * curr_de->Value_Count <= 4) {
+                curr_de->Value_Offset = ptr - seg->IFH_Base;
+            } else {
+                /* Offsets past the EXIF Segment are clamped to its end, never colliding with EXIF_POOL */
+                curr_de->Value_Offset = (val_ofst < tiff_len) ? val_ofst : tiff_len;
+            }
 
-                default: {
-                    printf("Unknown VALUE TYPE\n");
-                    return;
-                }
+            /* Evaluate the filter on the DEs of the first IFD of the chain */
+            if (seg->Filter != NULL && first_ifd) {
+                de_value(seg, curr_de, &val);
+                filter_entry(seg->Filter, idx, curr_de->Tag, &val);
             }
 
             /* Construct EXIF IFD and GPS IFD if exist */
             switch (curr_de->Tag) {
                 case 0x8769: {
-                    seg->EXIF_IFD = calloc(1, sizeof(struct Image_File_Directory));
-                    ifd_construct(seg, 1, val_ofst);
+                    if (idx == 0 && seg->Dir->EXIF_IFD == EXIF_NO_IFD) {
+                        ifd_construct(seg, 1, val_ofst);
+                    }
                     break;
                 }
 
                 case 0x8825: {
-                    seg->GPS_IFD = calloc(1, sizeof(struct Image_File_Directory));
-                    ifd_construct(seg, 2, val_ofst);
+                    if (idx == 0 && seg->Dir->GPS_IFD == EXIF_NO_IFD) {
+                        ifd_construct(seg, 2, val_ofst);
+                    }
                     break;
                 }
 
                 default: break;
             }
 
+            /* Give up on the file once the filter rejects it, keeping only the DEs constructed so far */
+            if (filter_rejected(seg->Filter)) {
+                de_cut(seg, ifd_idx, seg->Dir->IFDs[ifd_idx].First_DE + i + 1, de_cnt - i - 1);
+                return;
+            }
+
             /* Skip VALUE OFFSET, now pointing at TAG of the next DE */
             ptr += 4;
         }
 
-        /* Parse IFD OFFSET */
-        ifd_ofst = (need_byte_swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
+        /* Resolve the filter on the tags absent from the IFD, and from the private IFDs if not pointed at */
+        if (seg->Filter != NULL && first_ifd) {
+            filter_ifd_done(seg->Filter, idx);
+            if (idx == 0 && seg->Dir->EXIF_IFD == EXIF_NO_IFD) {
+                filter_ifd_done(seg->Filter, 1);
+            }
+            if (idx == 0 && seg->Dir->GPS_IFD == EXIF_NO_IFD) {
+                filter_ifd_done(seg->Filter, 2);
+            }
+
+            if (filter_rejected(seg->Filter)) {
+                return;
+            }
+        }
+
+        /* Parse IFD OFFSET, which is absent if the EXIF Segment ends early */
+        if ((uint64_t)(ptr - seg->IFH_Base) + 4 > tiff_len) {
+            break;
+        }
+        ifd_ofst = (seg->Byte_Swap) ? __builtin_bswap32(*(uint32_t *)ptr) : *(uint32_t *)ptr;
 
-        /* Abort if there is no more IFD */
-        if (ifd_ofst == 0) {
+        /* Abort if there is no more IFD, only TIFF IFDs being chained (IFD0, IFD1, ...) */
+        if (ifd_ofst == 0 || idx != 0 || ++chain_len == EXIF_MAX_CHAIN) {
             break;
         } else {
-            curr_ifd->Next_IFD = calloc(1, sizeof(struct Image_File_Directory));
-            curr_ifd = curr_ifd->Next_IFD;
+            prev_idx  = ifd_idx;
+            first_ifd = false;
         }
 
         /* Now pointing at DE COUNT of the next IFD */
@@ -230,27 +581,18 @@ void ifd_construct(struct EXIF_Segment *seg, uint8_t idx, uint32_t ifd_ofst) {
 void ifd_parse(struct EXIF_Segment *seg, uint8_t idx) {
     struct Image_File_Directory *curr_ifd = NULL;
     struct Directory_Entry      *curr_de  = NULL;
-    char *tag_name = NULL;
+    uint32_t                    val_cnt   = 0;
+    const char                  *tag_name = NULL;
+    char                        tag_hex[8];
+    char                        val[64];
 
-    switch (idx) {
-        case 0: {
-            curr_ifd = seg->Next_IFD;
-            break;
-        }
-        case 1: {
-            curr_ifd = seg->EXIF_IFD;
-            break;
-        }
-        case 2: {
-            curr_ifd = seg->GPS_IFD;
-            break;
-        }
-        default: {
-            printf("Unknown IFD index\n");
-            return;
-        }
+    if (idx > 2) {
+        printf("Unknown IFD index\n");
+        return;
     }
 
+    curr_ifd = ifd_select(seg, idx);
+
     while (curr_ifd != NULL && curr_ifd->DE_Count != 0) {
 
         printf("┌────────────────────────────────┬───────────┬───────┬───────────────────────────────────────────────────┐\n");
@@ -258,189 +600,641 @@ void ifd_parse(struct EXIF_Segment *seg, uint8_t idx) {
         printf("├────────────────────────────────┼───────────┼───────┼───────────────────────────────────────────────────┤\n");
 
         for (uint16_t i = 0; i < curr_ifd->DE_Count; i++) {
-            curr_de = &(curr_ifd->DEs[i]);
+            curr_de = &(dir_entries(seg->Dir)[curr_ifd->First_DE + i]);
+
+            /* Print the values lying within the EXIF Segment only */
+            val_cnt = de_fit_count(seg, curr_de);
+
+            if (type_size(curr_de->Value_Type) == 0) {
+                printf("Unknown VALUE TYPE\n");
+                return;
+            }
 
-            /* Obtain TAG description */
-            for (uint16_t i = 0; i < (sizeof(tags)/sizeof(struct Tag)); i++) {
-                if (tags[i].Number == curr_de->Tag) {
-                    tag_name = tags[i].Name;
+            /* Obtain TAG description, or the TAG in hex if unknown */
+            tag_name = NULL;
+            for (uint16_t j = 0; j < (sizeof(tags)/sizeof(struct Tag)); j++) {
+                if (tags[j].Number == curr_de->Tag) {
+                    tag_name = tags[j].Name;
                     break;
                 }
             }
 
-            /* In case of unknown TAG, print the TAG in hex */
             if (tag_name == NULL) {
-                printf("│ 0x%-25"PRIX16" │ %-9s │ %-5s │ %-49s │\n", curr_de->Tag, "", "", "");
+                snprintf(tag_hex, sizeof(tag_hex), "0x%04"PRIX16, curr_de->Tag);
+                tag_name = tag_hex;
             }
-            
+
+            /* ASCII strings are printed whole and UNDEFINED bytes are not printed */
             switch (curr_de->Value_Type) {
-                case BYTE: {
-                    uint8_t *ptr = (uint8_t *)(curr_de->Value);
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRIu8" │\n", tag_name, "BYTE", curr_de->Value_Count, *ptr);
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRIu8" │\n", "", "", "", *(ptr + i));
-                    }
-                    break;
-                }
+                case ASCII:     snprintf(val, sizeof(val), "%.*s", (int)val_cnt, (char *)de_data(seg, curr_de)); break;
+                case UNDEFINED: val[0] = '\0'; break;
+                default:        val[0] = '\0'; break;
+            }
 
-                case SBYTE: {
-                    int8_t *ptr = (int8_t *)(curr_de->Value);
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRId8" │\n", tag_name, "SBYTE", curr_de->Value_Count, *ptr);
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRId8" │\n", "", "", "", *(ptr + i));
-                    }
-                    break;
-                }
+            /* Values cut short by the end of the EXIF Segment are printed as far as they go */
+            if (val_cnt != 0 && curr_de->Value_Type != ASCII && curr_de->Value_Type != UNDEFINED) {
+                value_format(seg, curr_de, 0, val, sizeof(val));
+            }
 
-                case ASCII: {
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, "ASCII", curr_de->Value_Count, (char *)(curr_de->Value));
-                    break;
-                }
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, type_names[curr_de->Value_Type],
+                   curr_de->Value_Count, (val_cnt != 0) ? val : "");
 
-                case SHORT: {
-                    uint16_t *ptr = (uint16_t *)(curr_de->Value);
-                    uint16_t val  = 0;
+            for (uint32_t j = 1; j < val_cnt && curr_de->Value_Type != ASCII && curr_de->Value_Type != UNDEFINED; j++) {
+                value_format(seg, curr_de, j, val, sizeof(val));
+                printf("│ %-30s │ %-9s │ %-5s │ %-49s │\n", "", "", "", val);
+            }
 
-                    val = (need_byte_swap) ? __builtin_bswap16(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRIu16" │\n", tag_name, "SHORT", curr_de->Value_Count, val);
+            if (i == curr_ifd->DE_Count - 1) {
+                printf("└────────────────────────────────┴───────────┴───────┴───────────────────────────────────────────────────┘\n");
+            } else {
+                printf("├────────────────────────────────┼───────────┼───────┼───────────────────────────────────────────────────┤\n");
+            }
+        }
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap16(*ptr) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRIu16" │\n", "", "", "", val);
-                    }
+        curr_ifd = ifd_next(seg, curr_ifd);
+    }
+}
 
-                    break;
-                }
 
-                case SSHORT: {
-                    int16_t *ptr = (int16_t *)(curr_de->Value);
-                    int16_t val  = 0;
+/**
+ * @brief Obtain the size in bytes of a value of the given type, or 0 if the type is unknown.
+ */
+static uint8_t type_size(uint16_t type) {
+    switch (type) {
+        case BYTE:
+        case ASCII:
+        case SBYTE:
+        case UNDEFINED: return 1;
 
-                    val = (need_byte_swap) ? __builtin_bswap16(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRId16" │\n", tag_name, "SSHORT", curr_de->Value_Count, val);
+        case SHORT:
+        case SSHORT: return 2;
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap16(*ptr) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRId16" │\n", "", "", "", val);
-                    }
+        case LONG:
+        case SLONG:
+        case FLOAT: return 4;
 
-                    break;
-                }
+        case RATIONAL:
+        case SRATIONAL:
+        case DOUBLE: return 8;
 
-                case LONG: {
-                    uint32_t *ptr = (uint32_t *)(curr_de->Value);
-                    uint32_t val  = 0;
+        default: return 0;
+    }
+}
 
-                    val = (need_byte_swap) ? __builtin_bswap32(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRIu32" │\n", tag_name, "LONG", curr_de->Value_Count, val);
+/**
+ * @brief Find the Directory Entry of the given tag, or NULL if absent.
+ */
+static struct Directory_Entry *de_find(const struct EXIF_Segment *seg, const struct Image_File_Directory *ifd, uint16_t tag) {
+    struct Directory_Entry *des = &(dir_entries(seg->Dir)[ifd->First_DE]);
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap32(*ptr) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRIu32" │\n", "", "", "", val);
-                    }
+    for (uint16_t i = 0; i < ifd->DE_Count; i++) {
+        if (des[i].Tag == tag) {
+            return &(des[i]);
+        }
+    }
 
-                    break;
-                }
+    return NULL;
+}
 
-                case SLONG: {
-                    int32_t *ptr = (int32_t *)(curr_de->Value);
-                    int32_t val  = 0;
+/**
+ * @brief Insert a Directory Entry of the given tag, keeping the entries sorted by tag.
+ */
+static struct Directory_Entry *de_insert(struct EXIF_Segment *seg, uint16_t ifd_idx, uint16_t tag) {
+    struct Image_File_Directory *ifd = &(seg->Dir->IFDs[ifd_idx]);
+    uint32_t                    pos  = ifd->First_DE;
 
-                    val = (need_byte_swap) ? __builtin_bswap32(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRId32" │ %-49"PRId32" │\n", tag_name, "SLONG", curr_de->Value_Count, val);
+    while (pos < ifd->First_DE + ifd->DE_Count && dir_entries(seg->Dir)[pos].Tag < tag) {
+        pos++;
+    }
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap32(*ptr) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49"PRId32" │\n", "", "", "", val);
-                    }
+    de_splice(seg, ifd_idx, pos, 1);
+    dir_entries(seg->Dir)[pos].Tag = tag;
 
-                    break;
-                }
+    return &(dir_entries(seg->Dir)[pos]);
+}
 
-                case RATIONAL: {
-                    uint32_t *ptr = (uint32_t *)(curr_de->Value);
-                    uint32_t val1 = 0;
-                    uint32_t val2 = 0;
+/**
+ * @brief Obtain the first value of a SHORT or LONG Directory Entry.
+ */
+static uint32_t de_uint(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    return value_read(seg, de_data(seg, de), (de->Value_Type == SHORT) ? 2 : 4);
+}
 
-                    val1 = (need_byte_swap) ? __builtin_bswap32(*ptr) : *ptr;
-                    val2 = (need_byte_swap) ? __builtin_bswap32(*(ptr + 1)) : *(ptr + 1);
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49f │\n", tag_name, "RATIONAL", curr_de->Value_Count, (double)(val1 / val2));
+/**
+ * @brief Write the given values in host byte order into the given byte array in the byte order of the EXIF Segment.
+ */
+static void value_store(const struct EXIF_Segment *seg, uint8_t *dst, uint16_t type, uint32_t count, const void *value) {
+    uint8_t unit = (type == RATIONAL || type == SRATIONAL) ? 4 : type_size(type);
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val1 = (need_byte_swap) ? __builtin_bswap32(*(ptr + i)) : *(ptr + i);
-                        val2 = (need_byte_swap) ? __builtin_bswap32(*(ptr + 2*i + 1)) : *(ptr + 2*i + 1);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49f │\n", "", "", "", (double)(val1 / val2));
-                    }
+    memcpy(dst, value, count * type_size(type));
 
-                    break;
-                }
+    if (!seg->Byte_Swap) {
+        return;
+    }
 
-                case SRATIONAL: {
-                    int32_t *ptr = (int32_t *)(curr_de->Value);
-                    int32_t val1 = 0;
-                    int32_t val2 = 0;
+    for (uint32_t i = 0; i < count * type_size(type); i += unit) {
+        switch (unit) {
+            case 2: *(uint16_t *)(dst + i) = __builtin_bswap16(*(uint16_t *)(dst + i)); break;
+            case 4: *(uint32_t *)(dst + i) = __builtin_bswap32(*(uint32_t *)(dst + i)); break;
+            case 8: *(uint64_t *)(dst + i) = __builtin_bswap64(*(uint64_t *)(dst + i)); break;
+            default: break;
+        }
+    }
+}
 
-                    val1 = (need_byte_swap) ? __builtin_bswap32(*ptr) : *ptr;
-                    val2 = (need_byte_swap) ? __builtin_bswap32(*(ptr + 1)) : *(ptr + 1);
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49f │\n", tag_name, "SRATIONAL", curr_de->Value_Count, (double)(val1 / val2));
+/**
+ * @brief Allocate zeroed bytes for a patched value from the value pool, which may move the EXIF Directory.
+ * 
+ * @return The VALUE OFFSET of the patched value
+ */
+static uint32_t pool_alloc(struct EXIF_Segment *seg, uint32_t size) {
+    uint32_t ofst = seg->Dir->Pool_Length;
 
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val1 = (need_byte_swap) ? __builtin_bswap32(*(ptr + i)) : *(ptr + i);
-                        val2 = (need_byte_swap) ? __builtin_bswap32(*(ptr + 2*i + 1)) : *(ptr + 2*i + 1);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49f │\n", "", "", "", (double)(val1 / val2));
-                    }
+    /* Keep the values aligned for the accesses of `value_store` */
+    size = (size + 3) & ~3;
+    dir_reserve(seg, size);
+    memset(dir_pool(seg->Dir) + ofst, 0, size);
 
-                    break;
-                }
+    seg->Dir->Pool_Length += size;
+    seg->Dir->Size        += size;
 
-                case FLOAT: {
-                    float *ptr = (float *)(curr_de->Value);
-                    float val  = 0;
+    return EXIF_POOL | ofst;
+}
 
-                    val = (need_byte_swap) ? __builtin_bswap32(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49f │\n", tag_name, "FLOAT", curr_de->Value_Count, val);
-                    
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap32(*(ptr + i)) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49f │\n", "", "", "", val);
-                    }
+/**
+ * @brief Write a 16-bit or 32-bit value in the byte order of the EXIF Segment.
+ */
+static void put16(const struct EXIF_Segment *seg, uint8_t *dst, uint16_t val) {
+    *(uint16_t *)dst = (seg->Byte_Swap) ? __builtin_bswap16(val) : val;
+}
 
-                    break;
-                }
+static void put32(const struct EXIF_Segment *seg, uint8_t *dst, uint32_t val) {
+    *(uint32_t *)dst = (seg->Byte_Swap) ? __builtin_bswap32(val) : val;
+}
 
-                case DOUBLE: {
-                    double *ptr = (double *)(curr_de->Value);
-                    double val  = 0;
+/**
+ * @brief Check whether a Directory Entry is written by `exif_rebuild`, which drops values lying past the EXIF Segment.
+ */
+static bool de_emitted(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    switch (de->Tag) {
+        case TAG_EXIF_IFD:    return seg->Dir->EXIF_IFD != EXIF_NO_IFD;
+        case TAG_GPS_IFD:     return seg->Dir->GPS_IFD != EXIF_NO_IFD;
+        case TAG_INTEROP_IFD: return false;
+        default:              return de_fits(seg, de);
+    }
+}
 
-                    val = (need_byte_swap) ? __builtin_bswap64(*ptr) : *ptr;
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49f │\n", tag_name, "DOUBLE", curr_de->Value_Count, val);
-                    
-                    for (uint16_t i = 0; i < curr_de->Value_Count - 1; i++) {
-                        val = (need_byte_swap) ? __builtin_bswap64(*(ptr + i)) : *(ptr + i);
-                        printf("│ %-30s | %-9s │ %-5s │ %-49f │\n", "", "", "", val);
-                    }
+/**
+ * @brief Locate the JPEG thumbnail referenced by the given Image File Directory.
+ * 
+ * @return The length of the thumbnail, or 0 if absent or out of the APP1 Marker Segment
+ */
+static uint32_t thumbnail_locate(struct EXIF_Segment *seg, struct Image_File_Directory *ifd, uint8_t **thumb) {
+    struct Directory_Entry *ofst_de = de_find(seg, ifd, TAG_THUMBNAIL);
+    struct Directory_Entry *len_de  = de_find(seg, ifd, TAG_THUMBNAIL_LEN);
+    uint8_t                *end     = seg->APP1_Base + seg->APP1_Length;
+    uint32_t               len      = 0;
+
+    if (ofst_de == NULL || len_de == NULL) {
+        return 0;
+    }
 
-                    break;
-                }
+    *thumb = seg->IFH_Base + de_uint(seg, ofst_de);
+    len    = de_uint(seg, len_de);
 
-                case UNDEFINED: {
-                    printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, "UNDEFINED", curr_de->Value_Count, "");
-                    break;
-                }
+    return (*thumb < end && len <= (size_t)(end - *thumb)) ? len : 0;
+}
 
-                default: {
-                    printf("Unknown VALUE TYPE\n");
-                    return;
-                }
+int exif_set(struct EXIF_Segment *seg, uint8_t idx, uint16_t tag, uint16_t type, uint32_t count, const void *value) {
+    uint16_t               ifd_idx = ifd_index(seg, idx);
+    uint64_t               size    = (uint64_t)count * type_size(type);
+    uint32_t               ofst    = 0;
+    struct Directory_Entry *de     = NULL;
+
+    /* Offsets are maintained by the rebuild, and the values must fit in a Marker Segment */
+    if (type_size(type) == 0 || count == 0 || size > UINT16_MAX ||
+        tag == TAG_EXIF_IFD || tag == TAG_GPS_IFD || tag == TAG_INTEROP_IFD || tag == TAG_THUMBNAIL) {
+        return JPEG_ERROR;
+    }
+
+    /* Create EXIF IFD or GPS IFD, pointed at by a DE of the 0th IFD */
+    if (ifd_idx == EXIF_NO_IFD) {
+        if ((idx != 1 && idx != 2) || seg->Dir->IFD_Count == 0 || seg->Dir->IFD_Count == EXIF_MAX_IFDS ||
+            seg->Dir->IFDs[0].DE_Count == UINT16_MAX) {
+            return JPEG_ERROR;
+        }
+
+        ifd_idx = seg->Dir->IFD_Count++;
+        seg->Dir->IFDs[ifd_idx] = (struct Image_File_Directory){seg->Dir->DE_Count, 0, EXIF_NO_IFD};
+        if (idx == 1) {
+            seg->Dir->EXIF_IFD = ifd_idx;
+        } else {
+            seg->Dir->GPS_IFD = ifd_idx;
+        }
+
+        ofst = pool_alloc(seg, 4);
+        de   = de_find(seg, &(seg->Dir->IFDs[0]), (idx == 1) ? TAG_EXIF_IFD : TAG_GPS_IFD);
+        if (de == NULL) {
+            de = de_insert(seg, 0, (idx == 1) ? TAG_EXIF_IFD : TAG_GPS_IFD);
+        }
+        de->Value_Type   = LONG;
+        de->Value_Count  = 1;
+        de->Value_Offset = ofst;
+    }
+
+    de = de_find(seg, &(seg->Dir->IFDs[ifd_idx]), tag);
+
+    /* Overwrite in place if the type matches and the values fit in the space of the current values */
+    if (de != NULL && de->Value_Type == type && de_fits(seg, de) &&
+        (count == de->Value_Count || (type == ASCII && count < de->Value_Count))) {
+        memset(de_data(seg, de), 0, de->Value_Count * type_size(type));
+        value_store(seg, de_data(seg, de), type, count, value);
+        return JPEG_OK;
+    }
+
+    /* Otherwise change the IFD, to be serialized by the rebuild */
+    if (de == NULL && seg->Dir->IFDs[ifd_idx].DE_Count == UINT16_MAX) {
+        return JPEG_ERROR;
+    }
+
+    ofst = pool_alloc(seg, (size < 4) ? 4 : size);
+    de   = de_find(seg, &(seg->Dir->IFDs[ifd_idx]), tag);
+    if (de == NULL) {
+        de = de_insert(seg, ifd_idx, tag);
+    }
+
+    de->Value_Type   = type;
+    de->Value_Count  = count;
+    de->Value_Offset = ofst;
+    value_store(seg, de_data(seg, de), type, count, value);
+    seg->Dir->Dirty = true;
+
+    return JPEG_REBUILD;
+}
+
+int exif_remove(struct EXIF_Segment *seg, uint8_t idx, uint16_t tag) {
+    uint16_t               ifd_idx = ifd_index(seg, idx);
+    struct Directory_Entry *de     = (ifd_idx != EXIF_NO_IFD) ? de_find(seg, &(seg->Dir->IFDs[ifd_idx]), tag) : NULL;
+
+    if (de == NULL) {
+        return JPEG_ERROR;
+    }
+
+    de_cut(seg, ifd_idx, de - dir_entries(seg->Dir), 1);
+
+    /* Drop the IFD pointed at by the DE */
+    if (idx == 0 && tag == TAG_EXIF_IFD && seg->Dir->EXIF_IFD != EXIF_NO_IFD) {
+        ifd_drop(seg, seg->Dir->EXIF_IFD);
+    } else if (idx == 0 && tag == TAG_GPS_IFD && seg->Dir->GPS_IFD != EXIF_NO_IFD) {
+        ifd_drop(seg, seg->Dir->GPS_IFD);
+    }
+
+    seg->Dir->Dirty = true;
+
+    return JPEG_REBUILD;
+}
+
+int exif_rebuild(struct EXIF_Segment *seg) {
+    struct Image_File_Directory *ifds[EXIF_MAX_IFDS]      = {NULL};
+    uint32_t                    dir_ofsts[EXIF_MAX_IFDS] = {0};
+    uint8_t                     ifd_cnt                  = 0;
+    uint8_t                     chain_cnt                = 0;
+    uint8_t                     exif_idx                 = 0;
+    uint8_t                     gps_idx                  = 0;
+    uint64_t                    tiff_len                 = 8;
+    uint32_t                    data_ofst                = 0;
+    uint8_t                     *buf                     = NULL;
+    uint8_t                     *tiff                    = NULL;
+    uint8_t                     *ptr                     = NULL;
+
+    /* Order the IFDs as the 0th IFD chain, EXIF IFD and GPS IFD */
+    for (struct Image_File_Directory *ifd = ifd_select(seg, 0); ifd != NULL && ifd_cnt < EXIF_MAX_CHAIN; ifd = ifd_next(seg, ifd)) {
+        ifds[ifd_cnt++] = ifd;
+    }
+    chain_cnt = ifd_cnt;
+
+    if (ifd_select(seg, 1) != NULL) {
+        exif_idx = ifd_cnt;
+        ifds[ifd_cnt++] = ifd_select(seg, 1);
+    }
+
+    if (ifd_select(seg, 2) != NULL) {
+        gps_idx = ifd_cnt;
+        ifds[ifd_cnt++] = ifd_select(seg, 2);
+    }
+
+    /* Lay out the IFDs right after IFH, followed by the values not fitting in VALUE OFFSET */
+    for (uint8_t k = 0; k < ifd_cnt; k++) {
+        struct Directory_Entry *des    = &(dir_entries(seg->Dir)[ifds[k]->First_DE]);
+        uint16_t               de_cnt = 0;
+
+        for (uint16_t i = 0; i < ifds[k]->DE_Count; i++) {
+            de_cnt += de_emitted(seg, &(des[i]));
+        }
+
+        dir_ofsts[k] = tiff_len;
+        tiff_len += 2 + 12 * de_cnt + 4;
+    }
+
+    data_ofst = tiff_len;
+
+    for (uint8_t k = 0; k < ifd_cnt; k++) {
+        struct Directory_Entry *des   = &(dir_entries(seg->Dir)[ifds[k]->First_DE]);
+        uint8_t                *thumb = NULL;
+
+        for (uint16_t i = 0; i < ifds[k]->DE_Count; i++) {
+            uint64_t size = (uint64_t)des[i].Value_Count * type_size(des[i].Value_Type);
+
+            if (de_emitted(seg, &(des[i])) && size > 4) {
+                tiff_len += (size + 1) & ~1;
             }
-        
-            if (i == curr_ifd->DE_Count - 1) {
-                printf("└────────────────────────────────┴───────────┴───────┴───────────────────────────────────────────────────┘\n");
+        }
+
+        tiff_len += (thumbnail_locate(seg, ifds[k], &thumb) + 1) & ~1;
+    }
+
+    /* LENGTH covers itself, IDENTIFIER, IFH and IFDs */
+    if (2 + 6 + tiff_len > UINT16_MAX) {
+        printf("Rebuilt EXIF Segment is too large\n");
+        return JPEG_ERROR;
+    }
+
+    buf  = calloc(1, 2 + 2 + 6 + tiff_len);
+    tiff = buf + 2 + 2 + 6;
+
+    /* Write MARKER, LENGTH, IDENTIFIER, and IFH with the original BYTE ORDER */
+    *(uint16_t *)(buf + 0) = __builtin_bswap16(0xFFE1);
+    *(uint16_t *)(buf + 2) = __builtin_bswap16(2 + 6 + tiff_len);
+    memcpy(buf + 4, "Exif\0\0", 6);
+    memcpy(tiff, seg->IFH_Base, 4);
+    put32(seg, tiff + 4, 8);
+
+    /* Write IFDs */
+    for (uint8_t k = 0; k < ifd_cnt; k++) {
+        uint8_t  *thumb    = NULL;
+        uint32_t thumb_len = thumbnail_locate(seg, ifds[k], &thumb);
+        uint16_t de_cnt    = 0;
+
+        ptr = tiff + dir_ofsts[k] + 2;
+
+        for (uint16_t i = 0; i < ifds[k]->DE_Count; i++) {
+            struct Directory_Entry *de  = &(dir_entries(seg->Dir)[ifds[k]->First_DE + i]);
+            uint32_t               size = de->Value_Count * type_size(de->Value_Type);
+
+            if (!de_emitted(seg, de)) {
+                continue;
+            }
+
+            put16(seg, ptr + 0, de->Tag);
+            put16(seg, ptr + 2, de->Value_Type);
+            put32(seg, ptr + 4, de->Value_Count);
+
+            if (k < chain_cnt && de->Tag == TAG_EXIF_IFD) {
+                put32(seg, ptr + 8, dir_ofsts[exif_idx]);
+            } else if (k < chain_cnt && de->Tag == TAG_GPS_IFD) {
+                put32(seg, ptr + 8, dir_ofsts[gps_idx]);
+            } else if (de->Tag == TAG_THUMBNAIL) {
+                if (thumb_len != 0) {
+                    memcpy(tiff + data_ofst, thumb, thumb_len);
+                }
+                put32(seg, ptr + 8, (thumb_len != 0) ? data_ofst : 0);
+                data_ofst += (thumb_len + 1) & ~1;
+            } else if (size <= 4) {
+                memcpy(ptr + 8, de_data(seg, de), size);
             } else {
-                printf("├────────────────────────────────┼───────────┼───────┼───────────────────────────────────────────────────┤\n");
+                memcpy(tiff + data_ofst, de_data(seg, de), size);
+                put32(seg, ptr + 8, data_ofst);
+                data_ofst += (size + 1) & ~1;
+            }
+
+            ptr += 12;
+            de_cnt++;
+        }
+
+        /* Write DE COUNT and IFD OFFSET, only the 0th IFD chain is linked */
+        put16(seg, tiff + dir_ofsts[k], de_cnt);
+        put32(seg, ptr, (k + 1 < chain_cnt) ? dir_ofsts[k + 1] : 0);
+    }
+
+    free(seg->APP1_New);
+    seg->APP1_New        = buf;
+    seg->APP1_New_Length = 2 + 2 + 6 + tiff_len;
+
+    return JPEG_OK;
+}
+
+uint16_t exif_retain(struct EXIF_Segment *seg, const uint16_t *tags, uint16_t tag_count) {
+    struct Directory_Entry *des = NULL;
+    uint16_t               kept = 0;
+
+    if (seg->Dir == NULL || seg->Dir->IFD_Count == 0) {
+        return 0;
+    }
+
+    /* Drop the 1st IFD onwards, EXIF IFD and GPS IFD */
+    while (seg->Dir->IFD_Count > 1) {
+        ifd_drop(seg, seg->Dir->IFD_Count - 1);
+    }
+
+    /* Compact the retained DEs of the 0th IFD */
+    des = &(dir_entries(seg->Dir)[seg->Dir->IFDs[0].First_DE]);
+    for (uint16_t i = 0; i < seg->Dir->IFDs[0].DE_Count; i++) {
+        for (uint16_t j = 0; j < tag_count; j++) {
+            if (des[i].Tag == tags[j]) {
+                des[kept++] = des[i];
+                break;
             }
         }
+    }
+
+    de_cut(seg, 0, seg->Dir->IFDs[0].First_DE + kept, seg->Dir->IFDs[0].DE_Count - kept);
+    seg->Dir->Dirty = true;
+
+    return kept;
+}
+
+int exif_attach(struct EXIF_Segment *seg, uint8_t *app1, size_t app1_len, const void *dir, size_t len) {
+    const struct EXIF_Directory  *src     = dir;
+    const struct Directory_Entry *des     = NULL;
+    uint16_t                     seg_len  = 0;
+    uint32_t                     tiff_len = 0;
+
+    /* Check that LENGTH of the APP1 Marker Segment lies within the buffer, then MARKER and IDENTIFIER, and BYTE ORDER
+       unless no IFD was constructed */
+    if (app1_len < 4) {
+        return JPEG_ERROR;
+    }
+    seg_len = __builtin_bswap16(*(uint16_t *)(app1 + 2));
+    if ((size_t)seg_len + 2 > app1_len ||
+        app1[0] != 0xFF || app1[1] != 0xE1 || seg_len < 2 + 6 + 8 || memcmp(app1 + 4, "Exif", 5) != 0 ||
+        (len >= sizeof(struct EXIF_Directory) && src->IFD_Count != 0 &&
+         *(uint16_t *)(app1 + 10) != BYTE_ORDER_MM && *(uint16_t *)(app1 + 10) != BYTE_ORDER_II)) {
+        return JPEG_ERROR;
+    }
+    tiff_len = seg_len - 2 - 6;
+
+    /* Check the sizes and the references to IFDs */
+    if (len < sizeof(struct EXIF_Directory) || src->Size != len || src->IFD_Count > EXIF_MAX_IFDS ||
+        sizeof(struct EXIF_Directory) + (uint64_t)src->DE_Count * sizeof(struct Directory_Entry) + src->Pool_Length != len ||
+        (src->EXIF_IFD != EXIF_NO_IFD && src->EXIF_IFD >= src->IFD_Count) ||
+        (src->GPS_IFD != EXIF_NO_IFD && src->GPS_IFD >= src->IFD_Count)) {
+        return JPEG_ERROR;
+    }
+
+    /* Check that the IFDs are laid out in index order and chained forward, which rules out cycles */
+    for (uint16_t k = 0; k < src->IFD_Count; k++) {
+        const struct Image_File_Directory *ifd = &(src->IFDs[k]);
+
+        if ((uint64_t)ifd->First_DE + ifd->DE_Count > src->DE_Count ||
+            (k > 0 && ifd->First_DE < src->IFDs[k - 1].First_DE + src->IFDs[k - 1].DE_Count) ||
+            (ifd->Next_IFD != EXIF_NO_IFD && (ifd->Next_IFD <= k || ifd->Next_IFD >= src->IFD_Count))) {
+            return JPEG_ERROR;
+        }
+    }
+
+    /* Check that the values start within the EXIF Segment, or lie within the value pool */
+    des = (const struct Directory_Entry *)(src + 1);
+    for (uint32_t i = 0; i < src->DE_Count; i++) {
+        uint64_t size = (uint64_t)des[i].Value_Count * type_size(des[i].Value_Type);
+
+        if (type_size(des[i].Value_Type) == 0 ||
+            ((des[i].Value_Offset & EXIF_POOL) && (des[i].Value_Offset & ~EXIF_POOL) + size > src->Pool_Length) ||
+            (!(des[i].Value_Offset & EXIF_POOL) && des[i].Value_Offset > tiff_len)) {
+            return JPEG_ERROR;
+        }
+    }
+
+    seg->APP1_Base    = app1;
+    seg->APP1_Length  = seg_len + 2;
+    seg->IFH_Base     = app1 + 2 + 2 + 6;
+    seg->Byte_Swap    = (*(uint16_t *)seg->IFH_Base == BYTE_ORDER_MM);
+    seg->Dir          = malloc(len);
+    seg->Dir_Capacity = len;
+    memcpy(seg->Dir, dir, len);
+
+    return JPEG_OK;
+}
+
+/**
+ * @brief Sum the RATIONALs of a GPS DE as a sexagesimal number, the first in the given unit and each next in 1/60th
+ *        of the previous one (e.g. degrees, minutes and seconds).
+ * 
+ * @return true if the DE holds 1 to `max` RATIONALs lying within the EXIF Segment without a zero denominator
+ */
+static bool gps_sexagesimal(const struct EXIF_Segment *seg, const struct Directory_Entry *de, uint32_t max, double unit, double *sum) {
+    const uint8_t *data = NULL;
+
+    if (de == NULL || de->Value_Type != RATIONAL || de->Value_Count == 0 || de->Value_Count > max || !de_fits(seg, de)) {
+        return false;
+    }
+
+    data = de_data(seg, de);
+    *sum = 0;
+
+    for (uint32_t i = 0; i < de->Value_Count; i++, unit /= 60) {
+        uint32_t num = value_read(seg, data + 8 * i, 4);
+        uint32_t den = value_read(seg, data + 8 * i + 4, 4);
+
+        if (den == 0) {
+            return false;
+        }
+
+        *sum += (double)num / den * unit;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Obtain the first character of an ASCII GPS DE, or a null byte if absent.
+ */
+static char gps_ref(const struct EXIF_Segment *seg, const struct Directory_Entry *de) {
+    if (de == NULL || de->Value_Type != ASCII || de->Value_Count == 0 || !de_fits(seg, de)) {
+        return '\0';
+    }
+
+    return *(char *)de_data(seg, de);
+}
+
+int exif_gps(const struct EXIF_Segment *seg, struct JPEG_GPS *gps) {
+    struct Image_File_Directory *ifd = ifd_select(seg, 2);
+    struct Directory_Entry      *de  = NULL;
+    double                      lat  = 0;
+    double                      lon  = 0;
+    double                      alt  = 0;
+    double                      time = 0;
+    char                        ns   = '\0';
+    char                        ew   = '\0';
+
+    memset(gps, 0, sizeof(struct JPEG_GPS));
+
+    if (ifd == NULL) {
+        return JPEG_ERROR;
+    }
+
+    /* Latitude and Longitude, North and East if the Ref tags are absent */
+    ns = gps_ref(seg, de_find(seg, ifd, TAG_GPS_LATITUDE_REF));
+    ew = gps_ref(seg, de_find(seg, ifd, TAG_GPS_LONGITUDE_REF));
+
+    if (gps_sexagesimal(seg, de_find(seg, ifd, TAG_GPS_LATITUDE), 3, 1, &lat) &&
+        gps_sexagesimal(seg, de_find(seg, ifd, TAG_GPS_LONGITUDE), 3, 1, &lon) &&
+        lat <= 90 && lon <= 180 && (ns == '\0' || ns == 'N' || ns == 'S') && (ew == '\0' || ew == 'E' || ew == 'W')) {
+        gps->Latitude   = (ns == 'S') ? -lat : lat;
+        gps->Longitude  = (ew == 'W') ? -lon : lon;
+        gps->Fields    |= JPEG_GPS_POSITION;
+    }
+
+    /* Altitude, below the reference for odd Refs */
+    if (gps_sexagesimal(seg, de_find(seg, ifd, TAG_GPS_ALTITUDE), 1, 1, &alt)) {
+        de = de_find(seg, ifd, TAG_GPS_ALTITUDE_REF);
+        if (de != NULL && de->Value_Type == BYTE && de->Value_Count != 0 && de_fits(seg, de) && (*de_data(seg, de) & 1)) {
+            alt = -alt;
+        }
+
+        gps->Altitude  = alt;
+        gps->Fields   |= JPEG_GPS_ALTITUDE;
+    }
+
+    /* Time of day, allowing for a leap second */
+    if (gps_sexagesimal(seg, de_find(seg, ifd, TAG_GPS_TIME_STAMP), 3, 3600, &time) && time < 86401) {
+        gps->Time    = time;
+        gps->Fields |= JPEG_GPS_TIME;
+    }
+
+    /* Date as "YYYY:MM:DD" */
+    de = de_find(seg, ifd, TAG_GPS_DATE_STAMP);
+    if (de != NULL && de->Value_Type == ASCII && de->Value_Count >= 10 && de_fits(seg, de)) {
+        const char *date = (const char *)de_data(seg, de);
+        bool       valid = (date[4] == ':' && date[7] == ':');
+
+        for (int i = 0; i < 10 && valid; i++) {
+            valid = (i == 4 || i == 7 || (date[i] >= '0' && date[i] <= '9'));
+        }
+
+        if (valid) {
+            memcpy(gps->Date, date, 10);
+            gps->Fields |= JPEG_GPS_DATE;
+        }
+    }
+
+    return (gps->Fields != 0) ? JPEG_OK : JPEG_ERROR;
+}
+
+void exif_filter(const struct EXIF_Segment *seg, struct Filter_State *state) {
+    const struct Image_File_Directory *ifd = NULL;
+    const struct Directory_Entry      *de  = NULL;
+    struct Filter_Value               val  = {0};
+
+    /* Resolve the atoms on the DEs of the first IFD of each kind, as `ifd_construct` does */
+    for (uint8_t idx = 0; idx < 3; idx++) {
+        ifd = ifd_select(seg, idx);
+
+        for (uint16_t i = 0; ifd != NULL && i < ifd->DE_Count; i++) {
+            de = &(dir_entries(seg->Dir)[ifd->First_DE + i]);
+            de_value(seg, de, &val);
+            filter_entry(state, idx, de->Tag, &val);
+        }
 
-        curr_ifd = curr_ifd->Next_IFD;
+        filter_ifd_done(state, idx);
     }
 }
@@ -0,0 +1,482 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "filter.h"
+#include "tags.h"
+
+
+/**
+ * @brief Connectives of the three-valued logic, indexed by truth value (0 = FALSE, 1 = TRUE, 2 = UNKNOWN)
+ */
+static const uint8_t logic_and[3][3] = {
+    {0, 0, 0},
+    {0, 1, 2},
+    {0, 2, 2}
+};
+
+static const uint8_t logic_or[3][3] = {
+    {0, 1, 2},
+    {1, 1, 1},
+    {2, 1, 2}
+};
+
+static const uint8_t logic_not[3] = {1, 0, 2};
+
+/**
+ * @brief Expression being compiled
+ */
+struct Filter_Parser {
+    const char         *Ptr;    // The pointer to the next character
+    struct JPEG_Filter *Filter; // The predicate being compiled
+};
+
+static bool parse_or(struct Filter_Parser *parser);
+
+static void skip_space(struct Filter_Parser *parser) {
+    while (isspace((unsigned char)*parser->Ptr)) {
+        parser->Ptr++;
+    }
+}
+
+static bool is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+/**
+ * @brief Consume the given keyword (case-insensitive) if it is the next word.
+ */
+static bool parse_keyword(struct Filter_Parser *parser, const char *word) {
+    size_t len = strlen(word);
+
+    skip_space(parser);
+
+    if (strncasecmp(parser->Ptr, word, len) != 0 || is_word_char(parser->Ptr[len])) {
+        return false;
+    }
+
+    parser->Ptr += len;
+    return true;
+}
+
+/**
+ * @brief Consume the next word made of letters, digits, underscores and dots.
+ */
+static bool parse_word(struct Filter_Parser *parser, char *dst, size_t cap) {
+    size_t len = 0;
+
+    skip_space(parser);
+
+    while (is_word_char(parser->Ptr[len]) && len + 1 < cap) {
+        dst[len] = parser->Ptr[len];
+        len++;
+    }
+    dst[len] = '\0';
+
+    parser->Ptr += len;
+    return len > 0 && !is_word_char(*parser->Ptr);
+}
+
+/**
+ * @brief Compare a name with a tag name, ignoring the spaces of the latter and the case of both.
+ */
+static bool name_equal(const char *name, const char *tag_name) {
+    while (*name != '\0' || *tag_name != '\0') {
+        if (*tag_name == ' ') {
+            tag_name++;
+        } else if (tolower((unsigned char)*name) == tolower((unsigned char)*tag_name)) {
+            name++;
+            tag_name++;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Resolve a tag given by name (e.g. "DateTimeOriginal") or number (e.g. "0x9003").
+ */
+static bool resolve_tag(const char *name, uint16_t *tag) {
+    char          *end = NULL;
+    unsigned long num  = 0;
+
+    if (strncasecmp(name, "0x", 2) == 0) {
+        num  = strtoul(name + 2, &end, 16);
+        *tag = num;
+        return *end == '\0' && end != name + 2 && num <= 0xFFFF;
+    }
+
+    if (strcasecmp(name, "ISO") == 0) {
+        *tag = 0x8827;
+        return true;
+    }
+
+    for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+        if (name_equal(name, tags[i].Name)) {
+            *tag = tags[i].Number;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Parse a tag reference of the form [tiff.|exif.|gps.]NAME, where NAME is a tag name or number.
+ * 
+ * Without a prefix, GPS tags are looked up in the GPS IFD, Exif private tags in the EXIF IFD and the others in
+ * the TIFF IFD.
+ */
+static bool parse_ref(struct Filter_Parser *parser, uint8_t *idx, uint16_t *tag) {
+    char       word[64] = {0};
+    const char *name    = word;
+    const char *start   = NULL;
+
+    skip_space(parser);
+    start = parser->Ptr;
+
+    if (!parse_word(parser, word, sizeof(word))) {
+        return false;
+    }
+
+    if (strncasecmp(word, "tiff.", 5) == 0) {
+        *idx = 0;
+        name = word + 5;
+    } else if (strncasecmp(word, "exif.", 5) == 0) {
+        *idx = 1;
+        name = word + 5;
+    } else if (strncasecmp(word, "gps.", 4) == 0) {
+        *idx = 2;
+        name = word + 4;
+    }
+
+    /* Report an unknown tag at its name */
+    if (!resolve_tag(name, tag)) {
+        parser->Ptr = start;
+        return false;
+    }
+
+    if (name == word) {
+        *idx = (*tag < 0x0020) ? 2 : (*tag >= 0x829A && *tag != 0x8769 && *tag != 0x8825) ? 1 : 0;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Parse a comparison operator.
+ */
+static bool parse_op(struct Filter_Parser *parser, uint8_t *op) {
+    static const struct {
+        const char *Text;
+        uint8_t    Op;
+    } ops[] = {
+        {"!=", FILTER_OP_NE}, {"<>", FILTER_OP_NE}, {"<=", FILTER_OP_LE}, {">=", FILTER_OP_GE},
+        {"==", FILTER_OP_EQ}, {"=",  FILTER_OP_EQ}, {"<",  FILTER_OP_LT}, {">",  FILTER_OP_GT},
+    };
+
+    skip_space(parser);
+
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strncmp(parser->Ptr, ops[i].Text, strlen(ops[i].Text)) == 0) {
+            parser->Ptr += strlen(ops[i].Text);
+            *op = ops[i].Op;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Parse a quoted string or a number.
+ */
+static bool parse_literal(struct Filter_Parser *parser, struct Filter_Atom *atom) {
+    char   quote = 0;
+    char   *end  = NULL;
+    size_t len   = 0;
+
+    skip_space(parser);
+    quote = *parser->Ptr;
+
+    if (quote == '\'' || quote == '"') {
+        end = strchr(parser->Ptr + 1, quote);
+        len = (end != NULL) ? (size_t)(end - parser->Ptr - 1) : 0;
+        if (end == NULL || len >= FILTER_MAX_STRING) {
+            return false;
+        }
+
+        memcpy(atom->String, parser->Ptr + 1, len);
+        atom->String[len] = '\0';
+        atom->Is_String   = true;
+        parser->Ptr       = end + 1;
+        return true;
+    }
+
+    atom->Number = strtod(parser->Ptr, &end);
+    if (end == parser->Ptr || is_word_char(*end)) {
+        return false;
+    }
+
+    parser->Ptr = end;
+    return true;
+}
+
+static bool emit(struct Filter_Parser *parser, uint8_t code) {
+    if (parser->Filter->Code_Length == FILTER_MAX_CODE) {
+        return false;
+    }
+
+    parser->Filter->Code[parser->Filter->Code_Length++] = code;
+    return true;
+}
+
+/**
+ * @brief Parse a parenthesized expression, a negation, an existence test or a comparison.
+ */
+static bool parse_not(struct Filter_Parser *parser) {
+    struct JPEG_Filter *filter = parser->Filter;
+    struct Filter_Atom *atom   = NULL;
+
+    skip_space(parser);
+
+    if (*parser->Ptr == '(') {
+        parser->Ptr++;
+        if (!parse_or(parser)) {
+            return false;
+        }
+
+        skip_space(parser);
+        if (*parser->Ptr != ')') {
+            return false;
+        }
+
+        parser->Ptr++;
+        return true;
+    }
+
+    if (parse_keyword(parser, "NOT")) {
+        return parse_not(parser) && emit(parser, FILTER_CODE_NOT);
+    }
+
+    if (filter->Atom_Count == FILTER_MAX_ATOMS) {
+        return false;
+    }
+
+    atom = &(filter->Atoms[filter->Atom_Count]);
+
+    if (parse_keyword(parser, "HAS")) {
+        atom->Op = FILTER_OP_HAS;
+
+        /* "has EXIF" and "has GPS" test the pointers to the private IFDs */
+        if (parse_keyword(parser, "EXIF")) {
+            atom->Tag = 0x8769;
+        } else if (parse_keyword(parser, "GPS")) {
+            atom->Tag = 0x8825;
+        } else if (!parse_ref(parser, &atom->IFD, &atom->Tag)) {
+            return false;
+        }
+    } else if (!parse_ref(parser, &atom->IFD, &atom->Tag) || !parse_op(parser, &atom->Op) ||
+               !parse_literal(parser, atom)) {
+        return false;
+    }
+
+    return emit(parser, filter->Atom_Count++);
+}
+
+static bool parse_and(struct Filter_Parser *parser) {
+    if (!parse_not(parser)) {
+        return false;
+    }
+
+    while (parse_keyword(parser, "AND")) {
+        if (!parse_not(parser) || !emit(parser, FILTER_CODE_AND)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool parse_or(struct Filter_Parser *parser) {
+    if (!parse_and(parser)) {
+        return false;
+    }
+
+    while (parse_keyword(parser, "OR")) {
+        if (!parse_and(parser) || !emit(parser, FILTER_CODE_OR)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Apply a connective to every combination of the possible truth values of its operands.
+ */
+static uint8_t combine(uint8_t lhs, uint8_t rhs, const uint8_t table[3][3]) {
+    uint8_t out = 0;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t j = 0; j < 3; j++) {
+            if ((lhs & (1 << i)) && (rhs & (1 << j))) {
+                out |= 1 << table[i][j];
+            }
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Run the postfix program over the possible truth values of the atoms.
+ */
+static void evaluate(struct Filter_State *state) {
+    const struct JPEG_Filter *filter                = state->Filter;
+    uint8_t                  stack[FILTER_MAX_CODE] = {0};
+    uint8_t                  top                    = 0;
+    uint8_t                  code                   = 0;
+
+    for (uint8_t i = 0; i < filter->Code_Length; i++) {
+        code = filter->Code[i];
+
+        switch (code) {
+            case FILTER_CODE_AND: {
+                top--;
+                stack[top - 1] = combine(stack[top - 1], stack[top], logic_and);
+                break;
+            }
+
+            case FILTER_CODE_OR: {
+                top--;
+                stack[top - 1] = combine(stack[top - 1], stack[top], logic_or);
+                break;
+            }
+
+            case FILTER_CODE_NOT: {
+                uint8_t out = 0;
+                for (uint8_t j = 0; j < 3; j++) {
+                    out |= (stack[top - 1] & (1 << j)) ? 1 << logic_not[j] : 0;
+                }
+                stack[top - 1] = out;
+                break;
+            }
+
+            default: {
+                stack[top++] = state->Values[code];
+                break;
+            }
+        }
+    }
+
+    state->Outcome = stack[0];
+}
+
+/**
+ * @brief Compare the value of a DE with the operand of an atom.
+ */
+static uint8_t compare(const struct Filter_Atom *atom, const struct Filter_Value *val) {
+    size_t len     = 0;
+    size_t lit_len = 0;
+    int    cmp     = 0;
+
+    if (atom->Op == FILTER_OP_HAS) {
+        return FILTER_TRUE;
+    }
+
+    if (!val->Valid || val->Is_String != atom->Is_String) {
+        return FILTER_UNKNOWN;
+    }
+
+    if (atom->Is_String) {
+        /* Compare up to the null byte, ignoring the trailing spaces some cameras pad with */
+        len     = strnlen(val->String, val->Length);
+        lit_len = strlen(atom->String);
+        while (len > 0 && val->String[len - 1] == ' ') {
+            len--;
+        }
+
+        cmp = memcmp(val->String, atom->String, (len < lit_len) ? len : lit_len);
+        cmp = (cmp != 0) ? cmp : (len > lit_len) - (len < lit_len);
+    } else {
+        cmp = (val->Number > atom->Number) - (val->Number < atom->Number);
+    }
+
+    switch (atom->Op) {
+        case FILTER_OP_EQ: return (cmp == 0) ? FILTER_TRUE : FILTER_FALSE;
+        case FILTER_OP_NE: return (cmp != 0) ? FILTER_TRUE : FILTER_FALSE;
+        case FILTER_OP_LT: return (cmp <  0) ? FILTER_TRUE : FILTER_FALSE;
+        case FILTER_OP_LE: return (cmp <= 0) ? FILTER_TRUE : FILTER_FALSE;
+        case FILTER_OP_GT: return (cmp >  0) ? FILTER_TRUE : FILTER_FALSE;
+        case FILTER_OP_GE: return (cmp >= 0) ? FILTER_TRUE : FILTER_FALSE;
+        default:           return FILTER_UNKNOWN;
+    }
+}
+
+struct JPEG_Filter *filter_compile(const char *expr) {
+    struct Filter_Parser parser = {expr, calloc(1, sizeof(struct JPEG_Filter))};
+    bool                 valid  = parse_or(&parser);
+
+    skip_space(&parser);
+
+    if (!valid || *parser.Ptr != '\0') {
+        printf("Invalid filter at \"%s\"\n", parser.Ptr);
+        free(parser.Filter);
+        return NULL;
+    }
+
+    return parser.Filter;
+}
+
+void filter_free(struct JPEG_Filter *filter) {
+    free(filter);
+}
+
+void filter_init(struct Filter_State *state, const struct JPEG_Filter *filter) {
+    state->Filter = filter;
+    memset(state->Values, FILTER_PENDING, sizeof(state->Values));
+    evaluate(state);
+}
+
+void filter_entry(struct Filter_State *state, uint8_t idx, uint16_t tag, const struct Filter_Value *val) {
+    const struct JPEG_Filter *filter  = state->Filter;
+    bool                     changed = false;
+
+    for (uint8_t i = 0; i < filter->Atom_Count; i++) {
+        if (state->Values[i] == FILTER_PENDING && filter->Atoms[i].IFD == idx && filter->Atoms[i].Tag == tag) {
+            state->Values[i] = compare(&(filter->Atoms[i]), val);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        evaluate(state);
+    }
+}
+
+void filter_ifd_done(struct Filter_State *state, uint8_t idx) {
+    const struct JPEG_Filter *filter = state->Filter;
+    bool                     changed = false;
+
+    for (uint8_t i = 0; i < filter->Atom_Count; i++) {
+        if (state->Values[i] == FILTER_PENDING && filter->Atoms[i].IFD == idx) {
+            state->Values[i] = (filter->Atoms[i].Op == FILTER_OP_HAS) ? FILTER_FALSE : FILTER_UNKNOWN;
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        evaluate(state);
+    }
+}
+
+bool filter_rejected(const struct Filter_State *state) {
+    return state != NULL && !(state->Outcome & FILTER_TRUE);
+}
@@ -0,0 +1,145 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hash.h"
+
+
+#define PRIME64_1   0x9E3779B185EBCA87ULL
+#define PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3   0x165667B19E3779F9ULL
+#define PRIME64_4   0x85EBCA77C2B2AE63ULL
+#define PRIME64_5   0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *ptr) {
+    uint64_t val = 0;
+
+    memcpy(&val, ptr, 8);
+    return val;
+}
+
+static inline uint32_t read32(const uint8_t *ptr) {
+    uint32_t val = 0;
+
+    memcpy(&val, ptr, 4);
+    return val;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t hash_merge(uint64_t acc, uint64_t val) {
+    acc ^= hash_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ * @brief Consume 32-byte stripes, one 8-byte word per lane, so the four lanes run in parallel.
+ */
+static const uint8_t *hash_stripes(uint64_t *acc, const uint8_t *ptr, const uint8_t *end) {
+    uint64_t v1 = acc[0];
+    uint64_t v2 = acc[1];
+    uint64_t v3 = acc[2];
+    uint64_t v4 = acc[3];
+
+    while (ptr + 32 <= end) {
+        v1 = hash_round(v1, read64(ptr + 0));
+        v2 = hash_round(v2, read64(ptr + 8));
+        v3 = hash_round(v3, read64(ptr + 16));
+        v4 = hash_round(v4, read64(ptr + 24));
+        ptr += 32;
+    }
+
+    acc[0] = v1;
+    acc[1] = v2;
+    acc[2] = v3;
+    acc[3] = v4;
+
+    return ptr;
+}
+
+void hash_init(struct Hash_State *state, uint64_t seed) {
+    memset(state, 0, sizeof(struct Hash_State));
+    state->Seed   = seed;
+    state->Acc[0] = seed + PRIME64_1 + PRIME64_2;
+    state->Acc[1] = seed + PRIME64_2;
+    state->Acc[2] = seed;
+    state->Acc[3] = seed - PRIME64_1;
+}
+
+void hash_update(struct Hash_State *state, const uint8_t *ptr, size_t len) {
+    const uint8_t *end = ptr + len;
+
+    state->Total_Len += len;
+
+    /* Not enough bytes for a stripe yet */
+    if (state->Mem_Len + len < 32) {
+        memcpy(state->Mem + state->Mem_Len, ptr, len);
+        state->Mem_Len += len;
+        return;
+    }
+
+    /* Complete the pending stripe */
+    if (state->Mem_Len != 0) {
+        memcpy(state->Mem + state->Mem_Len, ptr, 32 - state->Mem_Len);
+        ptr += 32 - state->Mem_Len;
+        hash_stripes(state->Acc, state->Mem, state->Mem + 32);
+        state->Mem_Len = 0;
+    }
+
+    /* Consume the stripes directly from the byte range, keeping the tail */
+    ptr = hash_stripes(state->Acc, ptr, end);
+    memcpy(state->Mem, ptr, end - ptr);
+    state->Mem_Len = end - ptr;
+}
+
+uint64_t hash_digest(const struct Hash_State *state) {
+    const uint8_t *ptr = state->Mem;
+    const uint8_t *end = state->Mem + state->Mem_Len;
+    uint64_t      h    = 0;
+
+    if (state->Total_Len >= 32) {
+        h = rotl64(state->Acc[0], 1) + rotl64(state->Acc[1], 7) + rotl64(state->Acc[2], 12) + rotl64(state->Acc[3], 18);
+        h = hash_merge(h, state->Acc[0]);
+        h = hash_merge(h, state->Acc[1]);
+        h = hash_merge(h, state->Acc[2]);
+        h = hash_merge(h, state->Acc[3]);
+    } else {
+        h = state->Seed + PRIME64_5;
+    }
+
+    h += state->Total_Len;
+
+    /* Mix the tail */
+    for (; ptr + 8 <= end; ptr += 8) {
+        h ^= hash_round(0, read64(ptr));
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (ptr + 4 <= end) {
+        h ^= (uint64_t)read32(ptr) * PRIME64_1;
+        h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        ptr += 4;
+    }
+
+    for (; ptr < end; ptr++) {
+        h ^= (*ptr) * PRIME64_5;
+        h  = rotl64(h, 11) * PRIME64_1;
+    }
+
+    /* Avalanche */
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
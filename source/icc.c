@@ -0,0 +1,246 @@
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "jpeg.h"
+#include "icc.h"
+
+
+/* Length of IDENTIFIER, SEQUENCE NUMBER and CHUNK COUNT of an ICC Segment */
+#define ICC_HEADER_LEN  14
+
+/* Length of the profile header, followed by the tag table */
+#define ICC_PROFILE_HEADER_LEN  128
+
+/**
+ * @brief Read a big-endian 32-bit value from the reassembled profile.
+ */
+static int icc_read_u32(const struct ICC_Segment *seg, size_t ofst, uint32_t *val) {
+    uint32_t raw = 0;
+
+    if (icc_read(seg, ofst, &raw, 4) != 4) {
+        return JPEG_ERROR;
+    }
+
+    *val = __builtin_bswap32(raw);
+    return JPEG_OK;
+}
+
+/**
+ * @brief Copy a 4-byte signature into a null-terminated string.
+ */
+static void icc_signature(char *dst, const uint8_t *src) {
+    memcpy(dst, src, 4);
+    dst[4] = '\0';
+}
+
+/**
+ * @brief Decode the description tag at the given offset into ASCII.
+ * 
+ * Reference: ICC.1:2001-04, p.66 (textDescriptionType) and ICC.1:2010, p.63 (multiLocalizedUnicodeType)
+ */
+static void icc_description(const struct ICC_Segment *seg, uint32_t tag_ofst, uint32_t tag_size, char *dst, size_t cap) {
+    uint8_t  type[4]  = {0};
+    uint32_t str_len  = 0;
+    uint32_t str_ofst = 0;
+    size_t   n        = 0;
+
+    if (tag_size < 12 || icc_read(seg, tag_ofst, type, 4) != 4) {
+        return;
+    }
+
+    if (memcmp(type, "desc", 4) == 0) {
+        /* ASCII COUNT includes the terminating null byte */
+        if (icc_read_u32(seg, tag_ofst + 8, &str_len) != JPEG_OK) {
+            return;
+        }
+
+        n = (str_len < cap) ? str_len : cap - 1;
+        n = icc_read(seg, tag_ofst + 12, dst, n);
+        dst[n] = '\0';
+    } else if (memcmp(type, "mluc", 4) == 0) {
+        uint8_t  unit[2] = {0};
+        uint32_t rec_cnt = 0;
+
+        /* Use the first record, whose LENGTH and OFFSET follow its language and country codes */
+        if (icc_read_u32(seg, tag_ofst + 8, &rec_cnt) != JPEG_OK || rec_cnt == 0 ||
+            icc_read_u32(seg, tag_ofst + 20, &str_len) != JPEG_OK ||
+            icc_read_u32(seg, tag_ofst + 24, &str_ofst) != JPEG_OK) {
+            return;
+        }
+
+        /* Narrow UTF-16BE to ASCII */
+        for (uint32_t i = 0; i + 1 < str_len && n + 1 < cap; i += 2) {
+            if (icc_read(seg, tag_ofst + str_ofst + i, unit, 2) != 2) {
+                break;
+            }
+            dst[n++] = (unit[0] == 0 && unit[1] < 0x80) ? (char)unit[1] : '?';
+        }
+        dst[n] = '\0';
+    }
+}
+
+void icc_construct(struct ICC_Segment *seg, uint8_t **ptr) {
+    uint8_t  *seg_base = NULL;
+    uint16_t seg_len   = 0;
+    uint8_t  seq_num   = 0;
+    uint8_t  chunk_cnt = 0;
+
+    /* Skip MARKER, now pointing at LENGTH */
+    *ptr += 2;
+    seg_base = *ptr;
+
+    /* Parse LENGTH */
+    seg_len = __builtin_bswap16(**(uint16_t **)ptr);
+
+    /* SEQUENCE NUMBER and CHUNK COUNT lie within the Marker Segment only past the IDENTIFIER */
+    if (seg_len < 2 + ICC_HEADER_LEN) {
+        printf("Invalid ICC chunk\n");
+        *ptr = seg_base + seg_len;
+        return;
+    }
+
+    /* Skip LENGTH and IDENTIFIER, now pointing at SEQUENCE NUMBER */
+    *ptr += 2 + 12;
+
+    /* Parse SEQUENCE NUMBER and CHUNK COUNT */
+    seq_num   = (*ptr)[0];
+    chunk_cnt = (*ptr)[1];
+
+    if (seq_num == 0 || seq_num > chunk_cnt) {
+        printf("Invalid ICC chunk\n");
+    } else if (seg->Chunks[seq_num - 1].Base == NULL) {
+        /* Record the view of the chunk payload, ignoring duplicates */
+        seg->Chunks[seq_num - 1].Base   = *ptr + 2;
+        seg->Chunks[seq_num - 1].Length = seg_len - 2 - ICC_HEADER_LEN;
+        seg->Chunk_Found++;
+
+        if (chunk_cnt > seg->Chunk_Count) {
+            seg->Chunk_Count = chunk_cnt;
+        }
+    }
+
+    /* Skip ICC Segment, now pointing at MARKER of the next Marker Segment */
+    *ptr = seg_base + seg_len;
+}
+
+void icc_parse(struct ICC_Segment *seg) {
+    struct ICC_Profile_Info info = {0};
+
+    if (icc_info(seg, &info) != JPEG_OK) {
+        printf("Incomplete ICC profile (%"PRIu8" of %"PRIu8" chunks)\n\n", seg->Chunk_Found, seg->Chunk_Count);
+        return;
+    }
+
+    printf("┌──────────────────────────────────────────────────────────────────────────────────────────┐\n");
+    printf("│                                           APP2                                           │\n");
+    printf("├──────────────────────────────────┬───────────────────────────────────────────────────────┤\n");
+    printf("│ Chunk Count                      │ %-53"PRIu8" │\n", seg->Chunk_Count);
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Profile Size                     │ %-53"PRIu32" │\n", info.Size);
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Profile Version                  │ %"PRIu8".%-51"PRIu8" │\n", (uint8_t)(info.Version >> 24), (uint8_t)((info.Version >> 20) & 0xF));
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Profile Class                    │ %-53s │\n", info.Class);
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Color Space                      │ %-53s │\n", info.Color_Space);
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Profile Connection Space         │ %-53s │\n", info.PCS);
+    printf("├──────────────────────────────────┼───────────────────────────────────────────────────────┤\n");
+    printf("│ Description                      │ %-53.53s │\n", info.Description);
+    printf("└──────────────────────────────────┴───────────────────────────────────────────────────────┘\n\n");
+}
+
+void icc_free(struct ICC_Segment *seg) {
+    /* Nothing to be freed */
+}
+
+size_t icc_views(const struct ICC_Segment *seg, struct JPEG_View *views, size_t max) {
+    if (seg->Chunk_Found == 0 || seg->Chunk_Found != seg->Chunk_Count || seg->Chunk_Count > max) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < seg->Chunk_Count; i++) {
+        views[i] = seg->Chunks[i];
+    }
+
+    return seg->Chunk_Count;
+}
+
+size_t icc_read(const struct ICC_Segment *seg, size_t ofst, void *dst, size_t len) {
+    size_t copied = 0;
+    size_t n      = 0;
+
+    for (uint8_t i = 0; i < seg->Chunk_Count && copied < len; i++) {
+        const struct JPEG_View *chunk = &(seg->Chunks[i]);
+
+        /* Stop at the first missing chunk */
+        if (chunk->Base == NULL) {
+            break;
+        }
+
+        /* Skip chunks entirely before the requested range */
+        if (ofst >= chunk->Length) {
+            ofst -= chunk->Length;
+            continue;
+        }
+
+        n = chunk->Length - ofst;
+        n = (n < len - copied) ? n : len - copied;
+        memcpy((uint8_t *)dst + copied, chunk->Base + ofst, n);
+        copied += n;
+        ofst = 0;
+    }
+
+    return copied;
+}
+
+int icc_info(const struct ICC_Segment *seg, struct ICC_Profile_Info *info) {
+    uint8_t  hdr[ICC_PROFILE_HEADER_LEN] = {0};
+    uint8_t  entry[12]                   = {0};
+    uint32_t tag_cnt                     = 0;
+
+    memset(info, 0, sizeof(struct ICC_Profile_Info));
+
+    /* Only the header and the tag table are gathered, which normally lie in the first chunk */
+    if (seg->Chunk_Found != seg->Chunk_Count ||
+        icc_read(seg, 0, hdr, sizeof(hdr)) != sizeof(hdr) ||
+        icc_read_u32(seg, ICC_PROFILE_HEADER_LEN, &tag_cnt) != JPEG_OK) {
+        return JPEG_ERROR;
+    }
+
+    /* Parse PROFILE SIZE, VERSION, CLASS, COLOR SPACE and PCS */
+    info->Size    = __builtin_bswap32(*(uint32_t *)(hdr + 0));
+    info->Version = __builtin_bswap32(*(uint32_t *)(hdr + 8));
+    icc_signature(info->Class,       hdr + 12);
+    icc_signature(info->Color_Space, hdr + 16);
+    icc_signature(info->PCS,         hdr + 20);
+
+    /* Look up the description tag in the tag table */
+    for (uint32_t i = 0; i < tag_cnt; i++) {
+        if (icc_read(seg, ICC_PROFILE_HEADER_LEN + 4 + 12 * i, entry, 12) != 12) {
+            break;
+        }
+
+        if (memcmp(entry, "desc", 4) == 0) {
+            icc_description(seg, __builtin_bswap32(*(uint32_t *)(entry + 4)), __builtin_bswap32(*(uint32_t *)(entry + 8)),
+                            info->Description, sizeof(info->Description));
+            break;
+        }
+    }
+
+    /* Classify the well-known RGB working spaces by their description */
+    if (strstr(info->Description, "sRGB") != NULL) {
+        info->Kind = ICC_KIND_SRGB;
+    } else if (strstr(info->Description, "Display P3") != NULL) {
+        info->Kind = ICC_KIND_DISPLAY_P3;
+    } else if (strstr(info->Description, "Adobe RGB") != NULL) {
+        info->Kind = ICC_KIND_ADOBE_RGB;
+    } else {
+        info->Kind = ICC_KIND_UNKNOWN;
+    }
+
+    return JPEG_OK;
+}
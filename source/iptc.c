@@ -0,0 +1,324 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jpeg.h"
+#include "iptc.h"
+#include "tags.h"
+
+
+/**
+ * @brief Check whether the dataset of the given key is in the projection.
+ */
+static bool iptc_projected(const struct IPTC_Segment *seg, uint16_t key) {
+    if (seg->Projection == NULL) {
+        return true;
+    }
+
+    for (uint16_t i = 0; i < seg->Projection_Count; i++) {
+        if (seg->Projection[i] == key) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Walk the datasets of an IPTC-NAA record, storing the projected ones at `out` unless it is NULL.
+ * 
+ * Reference: IPTC-IIM v4.2, pp.14-15
+ * 
+ * @return The number of projected datasets
+ */
+static uint16_t iptc_walk(const struct IPTC_Segment *seg, uint8_t *ptr, uint8_t *end, struct IPTC_Dataset *out) {
+    uint16_t cnt     = 0;
+    uint16_t key     = 0;
+    uint32_t val_len = 0;
+
+    /* Each dataset starts with TAG MARKER, RECORD NUMBER, DATASET NUMBER and LENGTH */
+    while (ptr + 5 <= end && ptr[0] == 0x1C) {
+        key     = IPTC_KEY(ptr[1], ptr[2]);
+        val_len = __builtin_bswap16(*(uint16_t *)(ptr + 3));
+        ptr += 5;
+
+        /* Extended dataset, whose LENGTH holds the byte count of the actual length */
+        if (val_len & 0x8000) {
+            uint16_t len_len = val_len & 0x7FFF;
+
+            if (len_len > 4 || ptr + len_len > end) {
+                break;
+            }
+
+            val_len = 0;
+            for (uint16_t i = 0; i < len_len; i++) {
+                val_len = (val_len << 8) | *ptr++;
+            }
+        }
+
+        if (val_len > (size_t)(end - ptr)) {
+            printf("Truncated IPTC dataset\n");
+            break;
+        }
+
+        if (iptc_projected(seg, key)) {
+            if (out != NULL) {
+                out[cnt].Key    = key;
+                out[cnt].Length = val_len;
+                out[cnt].Value  = ptr;
+            }
+            cnt++;
+        }
+
+        ptr += val_len;
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief Parse `len` numeric characters as a decimal number.
+ * 
+ * @return true if every character is a digit
+ */
+static bool iptc_digits(const uint8_t *ptr, uint32_t len, int32_t *val) {
+    *val = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (ptr[i] < '0' || ptr[i] > '9') {
+            return false;
+        }
+        *val = *val * 10 + (ptr[i] - '0');
+    }
+
+    return true;
+}
+
+void iptc_construct(struct IPTC_Segment *seg, uint8_t **ptr) {
+    uint8_t  *seg_base = NULL;
+    uint8_t  *seg_end  = NULL;
+    uint16_t seg_len   = 0;
+    uint8_t  *res      = NULL;
+    uint16_t cnt       = 0;
+
+    /* Skip MARKER, now pointing at LENGTH */
+    *ptr += 2;
+    seg_base = *ptr;
+
+    /* Parse LENGTH */
+    seg_len = __builtin_bswap16(**(uint16_t **)ptr);
+    seg_end = seg_base + seg_len;
+
+    /* Skip LENGTH and IDENTIFIER, now pointing at the first image resource block */
+    res = seg_base + 2 + 14;
+
+    /* Walk image resource blocks, collecting the datasets of every IPTC-NAA record */
+    while (res + 12 <= seg_end && memcmp(res, "8BIM", 4) == 0) {
+        uint16_t res_id   = __builtin_bswap16(*(uint16_t *)(res + 4));
+        uint8_t  name_len = res[6];
+        uint8_t  *size_p  = res + 6 + ((1 + name_len + 1) & ~1);   // NAME is a Pascal string padded to even size
+        uint32_t res_size = 0;
+
+        if (size_p + 4 > seg_end) {
+            break;
+        }
+
+        res_size = __builtin_bswap32(*(uint32_t *)size_p);
+        if (res_size > (size_t)(seg_end - (size_p + 4))) {
+            printf("Truncated image resource block\n");
+            break;
+        }
+
+        if (res_id == IPTC_RESOURCE_ID) {
+            /* Count the projected datasets, then append them to those of the previous APP13 Marker Segments */
+            cnt = iptc_walk(seg, size_p + 4, size_p + 4 + res_size, NULL);
+            if (cnt != 0 && seg->Dataset_Count + cnt <= UINT16_MAX) {
+                seg->Datasets = realloc(seg->Datasets, (seg->Dataset_Count + cnt) * sizeof(struct IPTC_Dataset));
+                iptc_walk(seg, size_p + 4, size_p + 4 + res_size, seg->Datasets + seg->Dataset_Count);
+                seg->Dataset_Count += cnt;
+            }
+        }
+
+        /* Skip DATA padded to even size, now pointing at the next image resource block */
+        res = size_p + 4 + ((res_size + 1) & ~1);
+    }
+
+    /* Skip IPTC Segment, now pointing at MARKER of the next Marker Segment */
+    *ptr = seg_end;
+}
+
+const struct IPTC_Dataset *iptc_find(const struct IPTC_Segment *seg, uint16_t key, uint16_t nth) {
+    for (uint16_t i = 0; i < seg->Dataset_Count; i++) {
+        if (seg->Datasets[i].Key == key && nth-- == 0) {
+            return &(seg->Datasets[i]);
+        }
+    }
+
+    return NULL;
+}
+
+uint8_t iptc_type(uint16_t key) {
+    switch (key) {
+        /* Envelope Record [IPTC-IIM v4.2, pp.21-30] */
+        case IPTC_KEY(1, 0):        // Model Version
+        case IPTC_KEY(1, 20):       // File Format
+        case IPTC_KEY(1, 22):       // File Format Version
+        case IPTC_KEY(1, 120):      // ARM Identifier
+        case IPTC_KEY(1, 122):      // ARM Version
+            return IPTC_TYPE_SHORT;
+        case IPTC_KEY(1, 70):       // Date Sent
+            return IPTC_TYPE_DATE;
+        case IPTC_KEY(1, 80):       // Time Sent
+            return IPTC_TYPE_TIME;
+        case IPTC_KEY(1, 90):       // Coded Character Set
+            return IPTC_TYPE_BINARY;
+
+        /* Application Record [IPTC-IIM v4.2, pp.32-50] */
+        case IPTC_KEY(2, 0):        // Record Version
+        case IPTC_KEY(2, 200):      // ObjectData Preview File Format
+        case IPTC_KEY(2, 201):      // ObjectData Preview File Format Version
+            return IPTC_TYPE_SHORT;
+        case IPTC_KEY(2, 8):        // Editorial Update
+        case IPTC_KEY(2, 10):       // Urgency
+        case IPTC_KEY(2, 151):      // Audio Sampling Rate
+        case IPTC_KEY(2, 152):      // Audio Sampling Resolution
+            return IPTC_TYPE_DIGITS;
+        case IPTC_KEY(2, 30):       // Release Date
+        case IPTC_KEY(2, 37):       // Expiration Date
+        case IPTC_KEY(2, 47):       // Reference Date
+        case IPTC_KEY(2, 55):       // Date Created
+        case IPTC_KEY(2, 62):       // Digital Creation Date
+            return IPTC_TYPE_DATE;
+        case IPTC_KEY(2, 35):       // Release Time
+        case IPTC_KEY(2, 38):       // Expiration Time
+        case IPTC_KEY(2, 60):       // Time Created
+        case IPTC_KEY(2, 63):       // Digital Creation Time
+            return IPTC_TYPE_TIME;
+        case IPTC_KEY(2, 202):      // ObjectData Preview Data
+            return IPTC_TYPE_BINARY;
+
+        /* The other datasets of these records are graphic characters, those of the other records octets */
+        default:
+            return ((key >> 8) == 1 || (key >> 8) == 2) ? IPTC_TYPE_STRING : IPTC_TYPE_BINARY;
+    }
+}
+
+int iptc_int(const struct IPTC_Dataset *ds, int32_t *val) {
+    switch (iptc_type(ds->Key)) {
+        case IPTC_TYPE_SHORT:
+            if (ds->Length != 2) {
+                return JPEG_ERROR;
+            }
+            *val = (ds->Value[0] << 8) | ds->Value[1];
+            return JPEG_OK;
+
+        case IPTC_TYPE_DIGITS:
+            /* Up to 9 digits fit in int32_t */
+            if (ds->Length == 0 || ds->Length > 9 || !iptc_digits(ds->Value, ds->Length, val)) {
+                return JPEG_ERROR;
+            }
+            return JPEG_OK;
+
+        default:
+            return JPEG_ERROR;
+    }
+}
+
+int iptc_date(const struct IPTC_Dataset *ds, char date[11]) {
+    int32_t year  = 0;
+    int32_t month = 0;
+    int32_t day   = 0;
+
+    if (iptc_type(ds->Key) != IPTC_TYPE_DATE || ds->Length != 8 || !iptc_digits(ds->Value, 4, &year) ||
+        !iptc_digits(ds->Value + 4, 2, &month) || !iptc_digits(ds->Value + 6, 2, &day) || month > 12 || day > 31) {
+        return JPEG_ERROR;
+    }
+
+    snprintf(date, 11, "%04"PRId32":%02"PRId32":%02"PRId32, year, month, day);
+
+    return JPEG_OK;
+}
+
+int iptc_time(const struct IPTC_Dataset *ds, int32_t *time, int16_t *offset) {
+    int32_t hour   = 0;
+    int32_t minute = 0;
+    int32_t second = 0;
+    int32_t ofst_h = 0;
+    int32_t ofst_m = 0;
+
+    /* HHMMSS, then the sign and HHMM of the offset from UTC */
+    if (iptc_type(ds->Key) != IPTC_TYPE_TIME || ds->Length != 11 || !iptc_digits(ds->Value, 2, &hour) ||
+        !iptc_digits(ds->Value + 2, 2, &minute) || !iptc_digits(ds->Value + 4, 2, &second) ||
+        (ds->Value[6] != '+' && ds->Value[6] != '-') || !iptc_digits(ds->Value + 7, 2, &ofst_h) ||
+        !iptc_digits(ds->Value + 9, 2, &ofst_m) || hour > 23 || minute > 59 || second > 59 || ofst_h > 23 ||
+        ofst_m > 59) {
+        return JPEG_ERROR;
+    }
+
+    *time   = hour * 3600 + minute * 60 + second;
+    *offset = (int16_t)((ds->Value[6] == '-' ? -1 : 1) * (ofst_h * 60 + ofst_m));
+
+    return JPEG_OK;
+}
+
+void iptc_parse(struct IPTC_Segment *seg) {
+    struct IPTC_Dataset *curr_ds    = NULL;
+    char                *tag_name   = NULL;
+    char                key_str[8]  = {0};
+    char                value[50]   = {0};
+    int32_t             num         = 0;
+    int16_t             offset      = 0;
+
+    if (seg->Dataset_Count == 0) {
+        printf("No IPTC dataset decoded\n\n");
+        return;
+    }
+
+    printf("┌────────────────────────────────┬───────────┬───────┬───────────────────────────────────────────────────┐\n");
+    printf("│           Dataset              │    Key    │ Bytes │                       Value                       │\n");
+    printf("├────────────────────────────────┼───────────┼───────┼───────────────────────────────────────────────────┤\n");
+
+    for (uint16_t i = 0; i < seg->Dataset_Count; i++) {
+        curr_ds  = &(seg->Datasets[i]);
+        tag_name = "";
+
+        /* Obtain DATASET description */
+        for (uint16_t j = 0; j < (sizeof(iptc_tags)/sizeof(struct Tag)); j++) {
+            if (iptc_tags[j].Number == curr_ds->Key) {
+                tag_name = iptc_tags[j].Name;
+                break;
+            }
+        }
+
+        snprintf(key_str, sizeof(key_str), "%"PRIu8":%"PRIu8, (uint8_t)(curr_ds->Key >> 8), (uint8_t)curr_ds->Key);
+
+        /* Print the typed value, or the raw characters of strings and malformed values */
+        if (iptc_int(curr_ds, &num) == JPEG_OK) {
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49"PRId32" │\n", tag_name, key_str, curr_ds->Length, num);
+        } else if (iptc_date(curr_ds, value) == JPEG_OK) {
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, key_str, curr_ds->Length, value);
+        } else if (iptc_time(curr_ds, &num, &offset) == JPEG_OK) {
+            snprintf(value, sizeof(value), "%02"PRId32":%02"PRId32":%02"PRId32" UTC%c%02d:%02d", num / 3600,
+                     num / 60 % 60, num % 60, (offset < 0) ? '-' : '+', abs(offset) / 60, abs(offset) % 60);
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, key_str, curr_ds->Length, value);
+        } else if (iptc_type(curr_ds->Key) == IPTC_TYPE_BINARY) {
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49s │\n", tag_name, key_str, curr_ds->Length, "(binary)");
+        } else {
+            int val_len = (curr_ds->Length < 49) ? (int)curr_ds->Length : 49;
+            printf("│ %-30s │ %-9s │ %-5"PRIu32" │ %-49.*s │\n", tag_name, key_str, curr_ds->Length, val_len, (char *)(curr_ds->Value));
+        }
+
+        if (i == seg->Dataset_Count - 1) {
+            printf("└────────────────────────────────┴───────────┴───────┴───────────────────────────────────────────────────┘\n\n");
+        } else {
+            printf("├────────────────────────────────┼───────────┼───────┼───────────────────────────────────────────────────┤\n");
+        }
+    }
+}
+
+void iptc_free(struct IPTC_Segment *seg) {
+    free(seg->Datasets);
+}
@@ -1,39 +1,194 @@
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "jpeg.h"
 #include "jfif.h"
 #include "exif.h"
+#include "icc.h"
+#include "iptc.h"
+#include "hash.h"
+#include "dqt.h"
+#include "filter.h"
+#include "parser.h"
 
+/**
+ * @brief Outcomes of constructing a Marker Segment
+ */
+#define SEGMENT_SKIPPED 0   // The Marker Segment belongs to other applications
+#define SEGMENT_KEPT    1   // The Marker Segment was constructed, and the JPEG struct refers to its bytes
+#define SEGMENT_END     2   // The APP Marker Segments are over, or the file was rejected
+
+
+/**
+ * @brief Check whether the Marker Segment at the given byte array starts with the given identifier.
+ */
+static bool segment_has_identifier(const uint8_t *ptr, const char *id, size_t id_len) {
+    uint16_t seg_len = __builtin_bswap16(*(uint16_t *)(ptr + 2));
+
+    return seg_len >= 2 + id_len && memcmp(ptr + 4, id, id_len) == 0;
+}
+
+/**
+ * @brief Skip the Marker Segment at the given byte array.
+ */
+static void segment_skip(uint8_t **ptr) {
+    *ptr += 2 + __builtin_bswap16(*(uint16_t *)(*ptr + 2));
+}
+
+/**
+ * @brief Start the construction of a JPEG struct, with the evaluation of the filter if any.
+ */
+static void construct_begin(struct JPEG *jpeg) {
+    if (jpeg->Filter != NULL) {
+        jpeg->Filter_State = calloc(1, sizeof(struct Filter_State));
+        filter_init(jpeg->Filter_State, jpeg->Filter);
+    }
+}
+
+/**
+ * @brief Construct the APP Marker Segment at the given byte array, skipping the ones of other applications.
+ * 
+ * @return SEGMENT_SKIPPED, SEGMENT_KEPT if the JPEG struct refers to the bytes of the Marker Segment, or SEGMENT_END
+ *         if the APP Marker Segments are over or the file was rejected
+ */
+static int segment_construct(struct JPEG *jpeg, uint8_t **ptr) {
+    /* Parse MARKER */
+    uint16_t marker = __builtin_bswap16(*(uint16_t *)*ptr);
+
+    switch (marker) {
+        case 0xFFE0: {
+            if (jpeg->JFIF_Seg == NULL && segment_has_identifier(*ptr, "JFIF", 5)) {
+                jpeg->JFIF_Seg = calloc(1, sizeof(struct JFIF_Segment));
+                jfif_construct(jpeg->JFIF_Seg, ptr);
+                return SEGMENT_KEPT;
+            }
+            break;
+        }
+
+        case 0xFFE1: {
+            if (jpeg->EXIF_Seg == NULL && segment_has_identifier(*ptr, "Exif", 5)) {
+                jpeg->EXIF_Seg = calloc(1, sizeof(struct EXIF_Segment));
+                ((struct EXIF_Segment *)jpeg->EXIF_Seg)->Filter = jpeg->Filter_State;
+                exif_construct(jpeg->EXIF_Seg, ptr);
+
+                /* Stop once the file is rejected */
+                return filter_rejected(jpeg->Filter_State) ? SEGMENT_END : SEGMENT_KEPT;
+            }
+            break;
+        }
+
+        case 0xFFE2: {
+            if (segment_has_identifier(*ptr, "ICC_PROFILE", 12)) {
+                if (jpeg->ICC_Seg == NULL) {
+                    jpeg->ICC_Seg = calloc(1, sizeof(struct ICC_Segment));
+                }
+                icc_construct(jpeg->ICC_Seg, ptr);
+                return SEGMENT_KEPT;
+            }
+            break;
+        }
+
+        case 0xFFED: {
+            if (segment_has_identifier(*ptr, "Photoshop 3.0", 14)) {
+                if (jpeg->IPTC_Seg == NULL) {
+                    jpeg->IPTC_Seg = calloc(1, sizeof(struct IPTC_Segment));
+                    ((struct IPTC_Segment *)jpeg->IPTC_Seg)->Projection       = jpeg->IPTC_Projection;
+                    ((struct IPTC_Segment *)jpeg->IPTC_Seg)->Projection_Count = jpeg->IPTC_Projection_Count;
+                }
+                iptc_construct(jpeg->IPTC_Seg, ptr);
+                return SEGMENT_KEPT;
+            }
+            break;
+        }
+
+        case 0xFFE3 ... 0xFFEC:
+        case 0xFFEE ... 0xFFEF:
+        case 0xFFFE: break;
+
+        /* The tags not found so far are absent */
+        default: {
+            if (jpeg->Filter_State != NULL) {
+                filter_ifd_done(jpeg->Filter_State, 0);
+                filter_ifd_done(jpeg->Filter_State, 1);
+                filter_ifd_done(jpeg->Filter_State, 2);
+            }
+            return SEGMENT_END;
+        }
+    }
+
+    segment_skip(ptr);
+    return SEGMENT_SKIPPED;
+}
 
 void jpeg_construct(struct JPEG *jpeg, uint8_t *ptr) {
-    uint16_t marker = 0;
+    construct_begin(jpeg);
 
     /* Skip SOI Marker Segment, now pointing at APP Marker Segment */
     ptr += 2;
 
-    while (1) {
-        /* Parse MARKER */
-        marker = __builtin_bswap16(*(uint16_t *)ptr);
+    /* Construct the APP Marker Segments one after another */
+    while (segment_construct(jpeg, &ptr) != SEGMENT_END);
+}
 
-        /* Construct the corresponding APP Marker Segment */
-        switch (marker) {
-            case 0xFFE0: {
-                jpeg->JFIF_Seg = calloc(1, sizeof(struct JFIF_Segment));
-                jfif_construct(jpeg->JFIF_Seg, &ptr);
+struct JPEG_Parser *jpeg_parser_create(struct JPEG *jpeg) {
+    struct JPEG_Parser *parser = calloc(1, sizeof(struct JPEG_Parser));
+
+    parser->JPEG = jpeg;
+    construct_begin(jpeg);
+
+    return parser;
+}
+
+int jpeg_parser_feed(struct JPEG_Parser *parser, const uint8_t *chunk, size_t len) {
+    struct JPEG *jpeg   = parser->JPEG;
+    int         status  = JPEG_NEED_MORE_DATA;
+    int         ret     = JPEG_OK;
+    uint8_t     *seg    = NULL;
+    uint8_t     *ptr    = NULL;
+    bool        no_exif = false;
+
+    switch (parser->State) {
+        case PARSER_DONE:  return JPEG_DONE;
+        case PARSER_ERROR: return JPEG_ERROR;
+        default: break;
+    }
+
+    /* Construct each Marker Segment as soon as it is complete */
+    while ((ret = parser_next(parser, &chunk, &len, &seg)) == JPEG_OK) {
+        ptr     = seg;
+        no_exif = (jpeg->EXIF_Seg == NULL);
+
+        switch (segment_construct(jpeg, &ptr)) {
+            case SEGMENT_SKIPPED: {
+                parser_release(parser, false);
                 break;
             }
 
-            case 0xFFE1: {
-                jpeg->EXIF_Seg = calloc(1, sizeof(struct EXIF_Segment));
-                exif_construct(jpeg->EXIF_Seg, &ptr);
+            case SEGMENT_KEPT: {
+                parser_release(parser, true);
+                if (no_exif && jpeg->EXIF_Seg != NULL) {
+                    status = JPEG_EXIF_READY;
+                }
                 break;
             }
 
-            default: return;
+            default: {
+                parser_release(parser, true);
+                parser->State = PARSER_DONE;
+                return JPEG_DONE;
+            }
         }
     }
+
+    return (ret == JPEG_NEED_MORE_DATA) ? status : ret;
+}
+
+void jpeg_parser_free(struct JPEG_Parser *parser) {
+    parser_free(parser);
+    free(parser);
 }
 
 void jpeg_parse(struct JPEG *jpeg) {
@@ -44,12 +199,26 @@ void jpeg_parse(struct JPEG *jpeg) {
         printf("No presence of JFIF Segment\n");
     }
 
+    /* Parse ICC Segment */
+    if (jpeg->ICC_Seg != NULL) {
+        icc_parse(jpeg->ICC_Seg);
+    } else {
+        printf("No presence of ICC Segment\n");
+    }
+
     /* Parse EXIF Segment */
     if (jpeg->EXIF_Seg != NULL) {
         exif_parse(jpeg->EXIF_Seg);
     } else {
         printf("No presence of EXIF Segment\n");
     }
+
+    /* Parse IPTC Segment */
+    if (jpeg->IPTC_Seg != NULL) {
+        iptc_parse(jpeg->IPTC_Seg);
+    } else {
+        printf("No presence of IPTC Segment\n");
+    }
 }
 
 void jpeg_free(struct JPEG *jpeg) {
@@ -64,4 +233,693 @@ void jpeg_free(struct JPEG *jpeg) {
         exif_free(jpeg->EXIF_Seg);
         free(jpeg->EXIF_Seg);
     }
+
+    /* Free dynamic memory allocated to ICC Segment */
+    if (jpeg->ICC_Seg != NULL) {
+        icc_free(jpeg->ICC_Seg);
+        free(jpeg->ICC_Seg);
+    }
+
+    /* Free dynamic memory allocated to IPTC Segment */
+    if (jpeg->IPTC_Seg != NULL) {
+        iptc_free(jpeg->IPTC_Seg);
+        free(jpeg->IPTC_Seg);
+    }
+
+    /* Free the evaluation state of the filter */
+    free(jpeg->Filter_State);
+}
+
+size_t jpeg_icc_views(const struct JPEG *jpeg, struct JPEG_View *views, size_t max) {
+    return (jpeg->ICC_Seg != NULL) ? icc_views(jpeg->ICC_Seg, views, max) : 0;
+}
+
+size_t jpeg_icc_copy(const struct JPEG *jpeg, uint8_t *dst, size_t cap) {
+    struct ICC_Segment *seg = jpeg->ICC_Seg;
+    size_t             size = 0;
+
+    if (seg == NULL || seg->Chunk_Found == 0 || seg->Chunk_Found != seg->Chunk_Count) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < seg->Chunk_Count; i++) {
+        size += seg->Chunks[i].Length;
+    }
+
+    /* Only query the size */
+    if (dst == NULL) {
+        return size;
+    }
+
+    return (size <= cap) ? icc_read(seg, 0, dst, size) : 0;
+}
+
+int jpeg_icc_info(const struct JPEG *jpeg, struct ICC_Profile_Info *info) {
+    return (jpeg->ICC_Seg != NULL) ? icc_info(jpeg->ICC_Seg, info) : JPEG_ERROR;
+}
+
+
+int jpeg_iptc_get(const struct JPEG *jpeg, uint16_t key, uint16_t nth, struct JPEG_View *val) {
+    const struct IPTC_Dataset *ds = (jpeg->IPTC_Seg != NULL) ? iptc_find(jpeg->IPTC_Seg, key, nth) : NULL;
+
+    if (ds == NULL) {
+        return JPEG_ERROR;
+    }
+
+    val->Base   = ds->Value;
+    val->Length = ds->Length;
+
+    return JPEG_OK;
+}
+
+void jpeg_iptc_visit(const struct JPEG *jpeg, void (*visitor)(uint16_t key, const struct JPEG_View *val, void *arg), void *arg) {
+    struct IPTC_Segment *seg = jpeg->IPTC_Seg;
+    struct JPEG_View    val  = {0};
+
+    if (seg == NULL) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < seg->Dataset_Count; i++) {
+        val.Base   = seg->Datasets[i].Value;
+        val.Length = seg->Datasets[i].Length;
+        visitor(seg->Datasets[i].Key, &val, arg);
+    }
+}
+
+uint8_t jpeg_iptc_type(uint16_t key) {
+    return iptc_type(key);
+}
+
+int jpeg_iptc_get_int(const struct JPEG *jpeg, uint16_t key, uint16_t nth, int32_t *val) {
+    const struct IPTC_Dataset *ds = (jpeg->IPTC_Seg != NULL) ? iptc_find(jpeg->IPTC_Seg, key, nth) : NULL;
+
+    return (ds != NULL) ? iptc_int(ds, val) : JPEG_ERROR;
+}
+
+int jpeg_iptc_get_string(const struct JPEG *jpeg, uint16_t key, uint16_t nth, char *dst, size_t cap) {
+    const struct IPTC_Dataset *ds  = (jpeg->IPTC_Seg != NULL) ? iptc_find(jpeg->IPTC_Seg, key, nth) : NULL;
+    size_t                    len = 0;
+
+    if (ds == NULL || iptc_type(key) != IPTC_TYPE_STRING || cap == 0) {
+        return JPEG_ERROR;
+    }
+
+    len = (ds->Length < cap - 1) ? ds->Length : cap - 1;
+    memcpy(dst, ds->Value, len);
+    dst[len] = '\0';
+
+    return JPEG_OK;
+}
+
+int jpeg_iptc_get_date(const struct JPEG *jpeg, uint16_t key, uint16_t nth, char date[11]) {
+    const struct IPTC_Dataset *ds = (jpeg->IPTC_Seg != NULL) ? iptc_find(jpeg->IPTC_Seg, key, nth) : NULL;
+
+    return (ds != NULL) ? iptc_date(ds, date) : JPEG_ERROR;
+}
+
+int jpeg_iptc_get_time(const struct JPEG *jpeg, uint16_t key, uint16_t nth, int32_t *time, int16_t *offset) {
+    const struct IPTC_Dataset *ds = (jpeg->IPTC_Seg != NULL) ? iptc_find(jpeg->IPTC_Seg, key, nth) : NULL;
+
+    return (ds != NULL) ? iptc_time(ds, time, offset) : JPEG_ERROR;
+}
+
+int jpeg_exif_set(struct JPEG *jpeg, uint8_t idx, uint16_t tag, uint16_t type, uint32_t count, const void *value) {
+    return (jpeg->EXIF_Seg != NULL) ? exif_set(jpeg->EXIF_Seg, idx, tag, type, count, value) : JPEG_ERROR;
+}
+
+int jpeg_exif_remove(struct JPEG *jpeg, uint8_t idx, uint16_t tag) {
+    return (jpeg->EXIF_Seg != NULL) ? exif_remove(jpeg->EXIF_Seg, idx, tag) : JPEG_ERROR;
+}
+
+int jpeg_gps(const struct JPEG *jpeg, struct JPEG_GPS *gps) {
+    if (jpeg->EXIF_Seg == NULL) {
+        memset(gps, 0, sizeof(struct JPEG_GPS));
+        return JPEG_ERROR;
+    }
+
+    return exif_gps(jpeg->EXIF_Seg, gps);
+}
+
+int jpeg_exif_export(const struct JPEG *jpeg, struct JPEG_View *view) {
+    const struct EXIF_Segment *seg = jpeg->EXIF_Seg;
+
+    if (seg == NULL || seg->Dir == NULL) {
+        return JPEG_ERROR;
+    }
+
+    view->Base   = (const uint8_t *)seg->Dir;
+    view->Length = seg->Dir->Size;
+
+    return JPEG_OK;
+}
+
+int jpeg_exif_attach(struct JPEG *jpeg, uint8_t *app1, size_t app1_len, const void *dir, size_t len) {
+    struct EXIF_Segment *seg = NULL;
+
+    if (jpeg->EXIF_Seg != NULL) {
+        return JPEG_ERROR;
+    }
+
+    seg = calloc(1, sizeof(struct EXIF_Segment));
+    if (exif_attach(seg, app1, app1_len, dir, len) != JPEG_OK) {
+        free(seg);
+        return JPEG_ERROR;
+    }
+
+    jpeg->EXIF_Seg = seg;
+
+    return JPEG_OK;
+}
+
+size_t jpeg_exif_views(struct JPEG *jpeg, const uint8_t *file, size_t file_len, struct JPEG_View *views) {
+    struct EXIF_Segment *seg      = jpeg->EXIF_Seg;
+    const uint8_t       *app1_end = NULL;
+
+    if (seg == NULL || seg->APP1_Base == NULL) {
+        return 0;
+    }
+
+    app1_end = seg->APP1_Base + seg->APP1_Length;
+    if (seg->APP1_Base < file || app1_end > file + file_len) {
+        return 0;
+    }
+
+    /* Unchanged prefix up to MARKER of APP1 */
+    views[0].Base   = file;
+    views[0].Length = seg->APP1_Base - file;
+
+    /* APP1, patched in place or rebuilt */
+    if (seg->Dir->Dirty) {
+        if (exif_rebuild(seg) != JPEG_OK) {
+            return 0;
+        }
+        views[1].Base   = seg->APP1_New;
+        views[1].Length = seg->APP1_New_Length;
+    } else {
+        views[1].Base   = seg->APP1_Base;
+        views[1].Length = seg->APP1_Length;
+    }
+
+    /* Unchanged remainder */
+    views[2].Base   = app1_end;
+    views[2].Length = file + file_len - app1_end;
+
+    return 3;
+}
+
+int jpeg_segment(const uint8_t *ptr, size_t len, size_t ofst, struct JPEG_Segment *seg) {
+    /* Skip fill bytes, now pointing at the 0xFF preceding the marker code */
+    while (ofst + 1 < len && ptr[ofst] == 0xFF && ptr[ofst + 1] == 0xFF) {
+        ofst++;
+    }
+
+    if (ofst + 2 > len) {
+        return JPEG_NEED_MORE_DATA;
+    }
+
+    if (ptr[ofst] != 0xFF || ptr[ofst + 1] == 0x00) {
+        return JPEG_ERROR;
+    }
+
+    seg->Marker = 0xFF00 | ptr[ofst + 1];
+    seg->Offset = ofst;
+
+    switch (seg->Marker) {
+        /* TEM, RSTn, SOI and EOI have no LENGTH */
+        case 0xFF01:
+        case 0xFFD0 ... 0xFFD9: {
+            seg->Length = 2;
+            return JPEG_OK;
+        }
+
+        default: {
+            if (ofst + 4 > len) {
+                return JPEG_NEED_MORE_DATA;
+            }
+
+            seg->Length = 2 + ((ptr[ofst + 2] << 8) | ptr[ofst + 3]);
+            return (ofst + seg->Length <= len) ? JPEG_OK : JPEG_NEED_MORE_DATA;
+        }
+    }
+}
+
+bool jpeg_header_complete(const uint8_t *ptr, size_t len) {
+    struct JPEG_Segment seg  = {0};
+    size_t              ofst = 2;
+
+    if (len < 2 || ptr[0] != 0xFF || ptr[1] != 0xD8) {
+        return false;
+    }
+
+    while (jpeg_segment(ptr, len, ofst, &seg) == JPEG_OK) {
+        if ((seg.Marker & 0xFFF0) != 0xFFE0 && seg.Marker != 0xFFFE) {
+            return true;
+        }
+        ofst = seg.Offset + seg.Length;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Check whether a Marker Segment is kept, EXIF Segments aside.
+ */
+static bool strip_kept(const uint8_t *base, uint16_t marker, uint32_t keep) {
+    switch (marker) {
+        case 0xFFE0: return keep & JPEG_KEEP_JFIF;
+        case 0xFFE2: return keep & (segment_has_identifier(base, "ICC_PROFILE", 12) ? JPEG_KEEP_ICC : JPEG_KEEP_OTHER);
+        case 0xFFED: return keep & JPEG_KEEP_IPTC;
+        case 0xFFEE: return true;   // APP14 "Adobe" carries the color transform needed for decoding
+        case 0xFFFE: return keep & JPEG_KEEP_COMMENT;
+
+        case 0xFFE1: {
+            if (segment_has_identifier(base, "Exif", 5)) {
+                return keep & JPEG_KEEP_EXIF;
+            }
+            return keep & ((segment_has_identifier(base, "http://ns.adobe.com/", 20)) ? JPEG_KEEP_XMP : JPEG_KEEP_OTHER);
+        }
+
+        case 0xFFE3 ... 0xFFEC:
+        case 0xFFEF: return keep & JPEG_KEEP_OTHER;
+
+        default: return true;
+    }
+}
+
+/**
+ * @brief Append a range to the views, coalescing it with the last view if adjacent.
+ * 
+ * @return false if `max` is reached
+ */
+static bool strip_append(struct JPEG_View *views, size_t *view_cnt, size_t max, const uint8_t *base, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+
+    if (*view_cnt != 0 && views[*view_cnt - 1].Base + views[*view_cnt - 1].Length == base) {
+        views[*view_cnt - 1].Length += len;
+    } else if (*view_cnt < max) {
+        views[*view_cnt].Base   = base;
+        views[*view_cnt].Length = len;
+        (*view_cnt)++;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+size_t jpeg_strip_views(struct JPEG *jpeg, const uint8_t *file, size_t len, uint32_t keep, struct JPEG_View *views, size_t max) {
+    struct EXIF_Segment *exif    = jpeg->EXIF_Seg;
+    struct JPEG_Segment seg      = {0};
+    struct JPEG_View    app1     = {0};
+    size_t              view_cnt = 0;
+    size_t              ofst     = 2;
+    bool                kept     = false;
+
+    /* Reduce the EXIF Segment to Orientation, dropping it if there is no Orientation */
+    if ((keep & JPEG_KEEP_ORIENTATION) && !(keep & JPEG_KEEP_EXIF) && exif != NULL && exif->IFH_Base != NULL) {
+        uint16_t orientation = 0x0112;
+
+        if (exif_retain(exif, &orientation, 1) != 0 && exif_rebuild(exif) == JPEG_OK) {
+            app1.Base   = exif->APP1_New;
+            app1.Length = exif->APP1_New_Length;
+        }
+    }
+
+    /* Keep SOI */
+    if (len < 2 || max == 0) {
+        return 0;
+    }
+    views[view_cnt].Base   = file;
+    views[view_cnt].Length = 2;
+    view_cnt++;
+
+    while (jpeg_segment(file, len, ofst, &seg) == JPEG_OK) {
+        const uint8_t *base = file + seg.Offset;
+
+        /* The caller continues from SOS with `jpeg_strip_tail_views` */
+        if (seg.Marker == 0xFFDA) {
+            return view_cnt;
+        }
+
+        kept = strip_kept(base, seg.Marker, keep);
+
+        /* Substitute the reduced EXIF Segment */
+        if (!kept && app1.Base != NULL && exif->APP1_Base == base) {
+            if (view_cnt == max) {
+                return 0;
+            }
+            views[view_cnt++] = app1;
+            app1.Base = NULL;
+        }
+
+        if (kept && !strip_append(views, &view_cnt, max, base, seg.Length)) {
+            return 0;
+        }
+
+        ofst = seg.Offset + seg.Length;
+    }
+
+    return 0;
+}
+
+size_t jpeg_strip_tail_views(const uint8_t *file, size_t len, size_t ofst, uint32_t keep, struct JPEG_View *views,
+                             size_t max, bool *complete) {
+    struct JPEG_Segment seg      = {0};
+    size_t              view_cnt = 0;
+    const uint8_t       *ptr     = NULL;
+
+    *complete = false;
+
+    if (jpeg_segment(file, len, ofst, &seg) != JPEG_OK || seg.Marker != 0xFFDA) {
+        return 0;
+    }
+
+    for (;;) {
+        /* Keep every Marker Segment up to the next entropy-coded data or the next APPn or COM */
+        if (!strip_kept(file + seg.Offset, seg.Marker, keep)) {
+            ofst = seg.Offset + seg.Length;
+        } else if (seg.Marker == 0xFFD9) {
+            ofst      = (keep & JPEG_KEEP_TRAILER) ? len : seg.Offset + seg.Length;
+            *complete = true;
+            return strip_append(views, &view_cnt, max, file + seg.Offset, ofst - seg.Offset) ? view_cnt : 0;
+        } else {
+            if (!strip_append(views, &view_cnt, max, file + ofst, seg.Offset + seg.Length - ofst)) {
+                return 0;
+            }
+            ofst = seg.Offset + seg.Length;
+        }
+
+        /* Skip the entropy-coded data up to the next marker, other than RSTn and stuffed 0xFF */
+        for (size_t next = ofst; ; next = (ptr - file) + 1) {
+            ptr = memchr(file + next, 0xFF, len - next);
+            if (ptr == NULL || ptr + 1 == file + len) {
+                return strip_append(views, &view_cnt, max, file + ofst, len - ofst) ? view_cnt : 0;
+            }
+            if (ptr[1] != 0x00 && ptr[1] != 0xFF && (ptr[1] < 0xD0 || ptr[1] > 0xD7)) {
+                break;
+            }
+        }
+
+        /* Keep the data up to the marker (with its fill bytes), dropping a truncated Marker Segment */
+        if (!strip_append(views, &view_cnt, max, file + ofst, ptr - file - ofst)) {
+            return 0;
+        }
+        ofst = ptr - file;
+
+        if (jpeg_segment(file, len, ofst, &seg) != JPEG_OK) {
+            return view_cnt;
+        }
+    }
+}
+
+int jpeg_payload_hash(const uint8_t *ptr, size_t len, uint64_t *digest) {
+    struct Hash_State   state  = {0};
+    struct JPEG_Segment seg    = {0};
+    size_t              ofst   = 2;
+    int                 status = JPEG_OK;
+
+    if (len < 2 || ptr[0] != 0xFF || ptr[1] != 0xD8) {
+        return JPEG_ERROR;
+    }
+
+    hash_init(&state, 0);
+
+    while ((status = jpeg_segment(ptr, len, ofst, &seg)) == JPEG_OK) {
+        const uint8_t *data = ptr + seg.Offset + seg.Length;
+        const uint8_t *end  = ptr + len;
+
+        ofst = seg.Offset + seg.Length;
+
+        switch (seg.Marker) {
+            /* Skip metadata */
+            case 0xFFE0 ... 0xFFEF:
+            case 0xFFFE: break;
+
+            case 0xFFD9: {
+                hash_update(&state, ptr + seg.Offset, seg.Length);
+                *digest = hash_digest(&state);
+                return JPEG_OK;
+            }
+
+            case 0xFFDA: {
+                hash_update(&state, ptr + seg.Offset, seg.Length);
+
+                /* The entropy-coded data ends at the first marker other than a stuffed byte, RSTn or fill byte */
+                while (data < end) {
+                    const uint8_t *mark = memchr(data, 0xFF, end - data);
+
+                    if (mark == NULL || mark + 1 == end) {
+                        data = end;
+                        break;
+                    }
+
+                    data = mark + 1;
+                    if (mark[1] != 0x00 && mark[1] != 0xFF && (mark[1] < 0xD0 || mark[1] > 0xD7)) {
+                        data = mark;
+                        break;
+                    }
+                }
+
+                hash_update(&state, ptr + ofst, data - (ptr + ofst));
+                ofst = data - ptr;
+                break;
+            }
+
+            default: {
+                hash_update(&state, ptr + seg.Offset, seg.Length);
+                break;
+            }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Signatures recorded by the probe from the APP Marker Segments
+ */
+#define PROBE_SEEN_EXIF         0x01    // APP1 "Exif"
+#define PROBE_SEEN_PHOTOSHOP    0x02    // APP13 "Photoshop 3.0" or APP14 "Adobe"
+
+/**
+ * @brief Derive the quality, encoder and chroma subsampling once the frame and tables are known.
+ */
+static int probe_finish(struct JPEG_Info *info, const struct DQT_Tables *tables, const uint8_t *dest, uint8_t seen) {
+    bool    has_lum = tables->Present & (1 << dest[0]);
+    int     chroma  = -1;
+    uint8_t h_ratio = 0;
+    uint8_t v_ratio = 0;
+    bool    exact   = false;
+
+    /* Luminance is quantized by the table of the first component, chrominance by that of the second */
+    if (info->Component_Count > 1 && dest[1] != dest[0] && (tables->Present & (1 << dest[1]))) {
+        chroma = dest[1];
+    }
+
+    if (has_lum && !info->Lossless) {
+        exact = dqt_quality(tables, dest[0], chroma, &info->Quality) && (chroma >= 0 || info->Component_Count == 1);
+
+        /* Attribute other tables by the APP Marker Segments they come with, which is only a hint */
+        if (exact) {
+            info->Encoder = JPEG_ENCODER_LIBJPEG;
+        } else if (seen & PROBE_SEEN_PHOTOSHOP) {
+            info->Encoder = JPEG_ENCODER_PHOTOSHOP;
+        } else if (seen & PROBE_SEEN_EXIF) {
+            info->Encoder = JPEG_ENCODER_CAMERA;
+        }
+    }
+
+    /* Compare the sampling factors of luminance with those of the first chrominance component */
+    if (info->Component_Count == 1) {
+        strcpy(info->Subsampling, "gray");
+        return JPEG_OK;
+    }
+
+    if ((info->Sampling[1] >> 4) != 0 && (info->Sampling[1] & 0x0F) != 0 &&
+        (info->Sampling[0] >> 4) % (info->Sampling[1] >> 4) == 0 && (info->Sampling[0] & 0x0F) % (info->Sampling[1] & 0x0F) == 0) {
+        h_ratio = (info->Sampling[0] >> 4) / (info->Sampling[1] >> 4);
+        v_ratio = (info->Sampling[0] & 0x0F) / (info->Sampling[1] & 0x0F);
+    }
+
+    switch ((h_ratio << 4) | v_ratio) {
+        case 0x11: strcpy(info->Subsampling, "4:4:4"); break;
+        case 0x21: strcpy(info->Subsampling, "4:2:2"); break;
+        case 0x22: strcpy(info->Subsampling, "4:2:0"); break;
+        case 0x12: strcpy(info->Subsampling, "4:4:0"); break;
+        case 0x41: strcpy(info->Subsampling, "4:1:1"); break;
+        case 0x42: strcpy(info->Subsampling, "4:1:0"); break;
+        default:   strcpy(info->Subsampling, "other"); break;
+    }
+
+    return JPEG_OK;
+}
+
+int jpeg_probe(const uint8_t *ptr, size_t len, struct JPEG_Info *info) {
+    struct DQT_Tables tables  = {0};
+    uint8_t           dest[2] = {0};
+    uint8_t           seen    = 0;
+    size_t            ofst    = 2;
+    uint8_t           code    = 0;
+    size_t            seg_len = 0;
+
+    memset(info, 0, sizeof(struct JPEG_Info));
+
+    if (len < 2) {
+        return JPEG_NEED_MORE_DATA;
+    }
+
+    if (ptr[0] != 0xFF || ptr[1] != 0xD8) {
+        return JPEG_ERROR;
+    }
+
+    while (1) {
+        /* Skip fill bytes, now pointing at the 0xFF preceding the marker code */
+        while (ofst + 1 < len && ptr[ofst] == 0xFF && ptr[ofst + 1] == 0xFF) {
+            ofst++;
+        }
+
+        /* Past SOFn, the walk only looks for missing tables, so whatever stops it ends the probe */
+        if (ofst + 4 > len) {
+            return (info->SOF_Marker != 0) ? probe_finish(info, &tables, dest, seen) : JPEG_NEED_MORE_DATA;
+        }
+
+        if (ptr[ofst] != 0xFF) {
+            return (info->SOF_Marker != 0) ? probe_finish(info, &tables, dest, seen) : JPEG_ERROR;
+        }
+
+        /* Parse MARKER and LENGTH */
+        code    = ptr[ofst + 1];
+        seg_len = (ptr[ofst + 2] << 8) | ptr[ofst + 3];
+
+        switch (code) {
+            /* TEM and RSTn have no LENGTH */
+            case 0x01:
+            case 0xD0 ... 0xD7: {
+                ofst += 2;
+                continue;
+            }
+
+            /* No frame before SOI, EOI or SOS */
+            case 0x00:
+            case 0xD8:
+            case 0xD9:
+            case 0xDA: return (info->SOF_Marker != 0) ? probe_finish(info, &tables, dest, seen) : JPEG_ERROR;
+
+            /* SOFn, except DHT (C4), JPG (C8) and DAC (CC) */
+            case 0xC0 ... 0xC3:
+            case 0xC5 ... 0xC7:
+            case 0xC9 ... 0xCB:
+            case 0xCD ... 0xCF: {
+                const uint8_t *frame = ptr + ofst + 4;
+
+                if (ofst + 2 + seg_len > len) {
+                    return JPEG_NEED_MORE_DATA;
+                }
+
+                if (seg_len < 8) {
+                    return JPEG_ERROR;
+                }
+
+                /* Parse P, Y, X and Nf, then H, V and Tq of each component */
+                info->SOF_Marker      = 0xFF00 | code;
+                info->Precision       = frame[0];
+                info->Height          = (frame[1] << 8) | frame[2];
+                info->Width           = (frame[3] << 8) | frame[4];
+                info->Component_Count = frame[5];
+
+                for (uint8_t i = 0; i < info->Component_Count && i < 4 && 8 + 3 * i + 3 <= seg_len; i++) {
+                    info->Sampling[i] = frame[6 + 3 * i + 1];
+                    if (i < 2) {
+                        dest[i] = frame[6 + 3 * i + 2] & 0x03;
+                    }
+                }
+
+                info->Baseline      = (code == 0xC0);
+                info->Progressive   = ((code & 0x03) == 0x02);
+                info->Arithmetic    = (code >= 0xC9);
+                info->Lossless      = ((code & 0x03) == 0x03);
+                info->Header_Length = ofst + 2 + seg_len;
+
+                /* Stop here unless a table of the first two components is yet to be defined */
+                if (info->Lossless || ((tables.Present >> dest[0]) & (tables.Present >> dest[1]) & 1)) {
+                    return probe_finish(info, &tables, dest, seen);
+                }
+
+                ofst += 2 + seg_len;
+                break;
+            }
+
+            /* DQT */
+            case 0xDB: {
+                if (ofst + 2 + seg_len > len) {
+                    return (info->SOF_Marker != 0) ? probe_finish(info, &tables, dest, seen) : JPEG_NEED_MORE_DATA;
+                }
+
+                /* A malformed DQT leaves the tables it defined intact */
+                if (seg_len >= 2) {
+                    dqt_construct(&tables, ptr + ofst + 4, seg_len - 2);
+                }
+
+                ofst += 2 + seg_len;
+                if (info->SOF_Marker != 0) {
+                    info->Header_Length = ofst;
+                }
+                break;
+            }
+
+            /* Read the identifier of the APPs telling the encoder, skip their payload */
+            case 0xE1:
+            case 0xED:
+            case 0xEE: {
+                if (ofst + 18 <= len && segment_has_identifier(ptr + ofst, "Exif\0", 5)) {
+                    seen |= PROBE_SEEN_EXIF;
+                } else if (ofst + 18 <= len && (segment_has_identifier(ptr + ofst, "Photoshop 3.0", 14) ||
+                                                segment_has_identifier(ptr + ofst, "Adobe", 5))) {
+                    seen |= PROBE_SEEN_PHOTOSHOP;
+                }
+
+                ofst += 2 + seg_len;
+                break;
+            }
+
+            /* Skip the payload of any other Marker Segment without reading it */
+            default: {
+                ofst += 2 + seg_len;
+                break;
+            }
+        }
+    }
+}
+
+struct JPEG_Filter *jpeg_filter_compile(const char *expr) {
+    return filter_compile(expr);
+}
+
+void jpeg_filter_free(struct JPEG_Filter *filter) {
+    filter_free(filter);
+}
+
+bool jpeg_filter_match(const struct JPEG *jpeg) {
+    const struct Filter_State *state = jpeg->Filter_State;
+
+    return state == NULL || state->Outcome == FILTER_TRUE;
+}
+
+bool jpeg_filter_eval(const struct JPEG *jpeg, const struct JPEG_Filter *filter) {
+    struct Filter_State state = {0};
+
+    filter_init(&state, filter);
+
+    if (jpeg->EXIF_Seg != NULL) {
+        exif_filter(jpeg->EXIF_Seg, &state);
+    } else {
+        filter_ifd_done(&state, 0);
+        filter_ifd_done(&state, 1);
+        filter_ifd_done(&state, 2);
+    }
+
+    return state.Outcome == FILTER_TRUE;
 }
@@ -0,0 +1,152 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jpeg.h"
+#include "parser.h"
+
+
+/**
+ * @brief Check whether the Marker Segment of the given marker may be constructed by the library.
+ */
+static bool marker_constructed(uint16_t marker) {
+    return marker == 0xFFE0 || marker == 0xFFE1 || marker == 0xFFE2 || marker == 0xFFED;
+}
+
+/**
+ * @brief Check whether the Marker Segment of the given marker belongs to other applications.
+ */
+static bool marker_skipped(uint16_t marker) {
+    return (marker >= 0xFFE3 && marker <= 0xFFEC) || marker == 0xFFEE || marker == 0xFFEF || marker == 0xFFFE;
+}
+
+int parser_next(struct JPEG_Parser *parser, const uint8_t **chunk, size_t *len, uint8_t **seg) {
+    uint16_t marker = 0;
+    size_t   n      = 0;
+
+    while (1) {
+        switch (parser->State) {
+            case PARSER_SOI:
+            case PARSER_HEADER: {
+                if (*len == 0) {
+                    return JPEG_NEED_MORE_DATA;
+                }
+
+                /* Receive a byte of MARKER or LENGTH */
+                parser->Header[parser->Header_Length++] = **chunk;
+                *chunk += 1;
+                *len   -= 1;
+
+                if (parser->Header_Length < 2) {
+                    break;
+                }
+
+                marker = (parser->Header[0] << 8) | parser->Header[1];
+
+                /* Check SOI Marker Segment */
+                if (parser->State == PARSER_SOI) {
+                    if (marker != 0xFFD8) {
+                        parser->State = PARSER_ERROR;
+                        return JPEG_ERROR;
+                    }
+
+                    parser->State         = PARSER_HEADER;
+                    parser->Header_Length = 0;
+                    break;
+                }
+
+                /* Skip fill bytes before MARKER */
+                if (marker == 0xFFFF) {
+                    parser->Header_Length = 1;
+                    break;
+                }
+
+                /* Hand MARKER over once the APP Marker Segments are over */
+                if (!marker_constructed(marker) && !marker_skipped(marker)) {
+                    parser->State = PARSER_DONE;
+                    *seg = parser->Header;
+                    return JPEG_OK;
+                }
+
+                if (parser->Header_Length < 4) {
+                    break;
+                }
+
+                /* Parse LENGTH, which covers itself */
+                parser->Segment_Length = 2 + ((parser->Header[2] << 8) | parser->Header[3]);
+                parser->Received       = 4;
+                parser->Header_Length  = 0;
+
+                if (parser->Segment_Length < 4) {
+                    parser->State = PARSER_ERROR;
+                    return JPEG_ERROR;
+                }
+
+                if (marker_constructed(marker)) {
+                    parser->Segment = calloc(1, parser->Segment_Length + PARSER_PADDING);
+                    memcpy(parser->Segment, parser->Header, 4);
+                    parser->State = PARSER_BODY;
+                } else {
+                    parser->State = PARSER_SKIP;
+                }
+                break;
+            }
+
+            case PARSER_BODY:
+            case PARSER_SKIP: {
+                /* Receive or skip the bytes of the Marker Segment in the chunk */
+                n = parser->Segment_Length - parser->Received;
+                n = (n < *len) ? n : *len;
+
+                if (parser->State == PARSER_BODY) {
+                    memcpy(parser->Segment + parser->Received, *chunk, n);
+                }
+
+                *chunk           += n;
+                *len             -= n;
+                parser->Received += n;
+
+                if (parser->Received < parser->Segment_Length) {
+                    return JPEG_NEED_MORE_DATA;
+                }
+
+                if (parser->State == PARSER_SKIP) {
+                    parser->State = PARSER_HEADER;
+                    break;
+                }
+
+                /* Hand the Marker Segment over until released */
+                *seg = parser->Segment;
+                return JPEG_OK;
+            }
+
+            default: return JPEG_ERROR;
+        }
+    }
+}
+
+void parser_release(struct JPEG_Parser *parser, bool keep) {
+    if (parser->Segment != NULL) {
+        if (keep) {
+            parser->Buffers = realloc(parser->Buffers, (parser->Buffer_Count + 1) * sizeof(uint8_t *));
+            parser->Buffers[parser->Buffer_Count++] = parser->Segment;
+        } else {
+            free(parser->Segment);
+        }
+        parser->Segment = NULL;
+    }
+
+    if (parser->State == PARSER_BODY) {
+        parser->State = PARSER_HEADER;
+    }
+}
+
+void parser_free(struct JPEG_Parser *parser) {
+    for (size_t i = 0; i < parser->Buffer_Count; i++) {
+        free(parser->Buffers[i]);
+    }
+    free(parser->Buffers);
+    free(parser->Segment);
+}